@@ -5,6 +5,7 @@
 
 #include "../structures/imagetree.h"
 #include "../structures/node.h"
+#include "../structures/levelancestors.h"
 
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -31,37 +32,31 @@ typedef std::pair<int, bool> mserData;
 #define emptyData(sz) (std::make_pair( (sz), true))
 
 namespace fl{
-    mserData areaDiff(Node *root, const int deltaLvl){
-        Node *high = root;
-
-        double cumulative = 0;
-        for (; high->_parent != NULL; high = high->_parent){
-            double thisStep = std::abs(high->level() - high->_parent->level());
-            if ((cumulative + thisStep) > deltaLvl)
-                break;
-            cumulative += thisStep;
-        }
+    // the highest ancestor within deltaLvl is found by binary lifting on the cumulative level variation
+    mserData areaDiff(const LevelAncestors &anc, Node *root, const int deltaLvl){
+        int self = anc.index(root);
+        int high = anc.highestAncestorByVariation(self, deltaLvl);
 
-        mserData rValue = emptyData(root->elementCount() + 1);
+        mserData rValue = emptyData(anc.elementCount(self) + 1);
 
-        rValue.diff = high->elementCount() - root->elementCount();
+        rValue.diff = anc.elementCount(high) - anc.elementCount(self);
         return rValue;
     }
 
-    mserData mserRecursive(Node *root, const int deltaLvl, std::vector <Node * > &mserOrder, std::vector <std::pair<double, int> > &div,
+    mserData mserRecursive(const LevelAncestors &anc, Node *root, const int deltaLvl, std::vector <Node * > &mserOrder, std::vector <std::pair<double, int> > &div,
                            int minArea, double maxVariation){
 
         int myElems = root->elementCount();
         if (myElems < minArea){
-            return areaDiff(root, deltaLvl);
+            return areaDiff(anc, root, deltaLvl);
         }
 
-        mserData forRoot = areaDiff(root, deltaLvl);
+        mserData forRoot = areaDiff(anc, root, deltaLvl);
 
         for (int i=0, szi = root->_children.size(); i < szi; ++i){
 
             int childElems = root->_children[i]->elementCount();
-            mserData child = mserRecursive(root->_children[i], deltaLvl, mserOrder, div, minArea, maxVariation);
+            mserData child = mserRecursive(anc, root->_children[i], deltaLvl, mserOrder, div, minArea, maxVariation);
 
             if (std::abs(root->level()-root->_children[i]->level()) > 1){
                 if (child.ext && childElems >= minArea && child.diff<maxVariation*childElems){
@@ -153,7 +148,8 @@ namespace fl{
         if (maxArea <= 0)
             maxArea = tree.treeHeight()*tree.treeWidth();
 
-        mserRecursive(tree._root, deltaLvl, mser, div, minArea, maxVariation);
+        std::shared_ptr <const LevelAncestors> anc = tree.levelAncestors();
+        mserRecursive(*anc, tree._root, deltaLvl, mser, div, minArea, maxVariation);
         mserTrimDiversity(mser, div, minDiversity, maxArea);
 
         return;
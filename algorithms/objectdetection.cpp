@@ -4,7 +4,7 @@
 
 #include "objectdetection.h"
 
-#include "../structures/areaattribute.h"
+#include "../structures/levelancestors.h"
 
 #include <algorithm>
 #include <set>
@@ -100,21 +100,22 @@ namespace fl{
 
         std::cout << "Selecting nodes" << std::endl;
 
-        tree.addAttributeToTree<AreaAttribute>(new AreaSettings());
+        std::shared_ptr <const LevelAncestors> anc = tree.levelAncestors();
         std::set <Node *> visited; // mark visited nodes along branches to reduce double-processing
         for (int i=0, szi = (int)leafExt.size(); i < szi; ++i){
-            Node *cur, *par;
 
             // populate the allGrowth vector with all values in this branch
             std::vector<std::pair<double, std::pair<int, Node *> > > allGrowth; // (growth, (area, node))
-            for (cur = par = leafExt[i].second; !cur->isRoot(); cur = cur->parent()){
-                for (; !par->parent()->isRoot() && std::abs(cur->level() - par->parent()->level()) <= delta; par = par->parent()); // find the ancestor
-                int parentArea = ((fl::AreaAttribute*)par->getAttribute(AreaAttribute::name))->value();
-                int selfArea = ((fl::AreaAttribute*)cur->getAttribute(AreaAttribute::name))->value();
+            for (int cur = anc->index(leafExt[i].second); cur > 0; cur = anc->parent(cur)){
+                // find the ancestor just below the first one beyond delta (never the root)
+                int beyond = std::max(anc->firstAncestorBeyondLevel(cur, delta), 0);
+                int par = anc->ancestor(cur, anc->depth(cur) - anc->depth(beyond) - 1);
+                int parentArea = anc->elementCount(par);
+                int selfArea = anc->elementCount(cur);
                 if (selfArea > (int)(maxArea*1.15)) // examine a bit above maxArea if you need for later
                     break;
                 double growth = (double)(parentArea - selfArea) / selfArea;
-                allGrowth.emplace_back(std::make_pair(growth, std::make_pair(selfArea, cur)));
+                allGrowth.emplace_back(std::make_pair(growth, std::make_pair(selfArea, anc->node(cur))));
             }
             std::sort(allGrowth.rbegin(), allGrowth.rend());
 
@@ -150,7 +151,5 @@ namespace fl{
                 visited.emplace(allGrowth[bestIndex].second.second);
             }
         }
-
-        tree.deleteAttributeFromTree<fl::AreaAttribute>();
     }
 }
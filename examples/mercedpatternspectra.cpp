@@ -8,8 +8,12 @@
 #include <utility>
 #include <algorithm>
 #include <iomanip>
+#include <mutex>
 
 #include "../misc/misc.h"
+#include "../misc/parallel.h"
+#include "../misc/descriptorfile.h"
+#include "../misc/retrieval.h"
 
 #include "../structures/imagetree.h"
 #include "../algorithms/maxtreenister.h"
@@ -72,10 +76,150 @@ double averagePrecision(const std::vector<char> &response){
     return sum / (double)totalRelevant;
 }
 
+void tilingWindows(int rows, int cols, int startSize, int pyramidFactor, std::vector <cv::Rect> &windows){
+    windows.clear();
+    for (int dim = startSize, offset = 16; dim < std::min(256,std::max(cols, rows))+2; dim *= pyramidFactor){
+        for (int _i=0; !_i || (_i - offset + dim < cols-2); _i += offset){
+            int dimi = std::min(cols-_i, dim);
+            if (dimi <= 2)
+                break;
+            for (int _j=0; !_j || (_j - offset + dim < rows-2); _j += offset){
+                int dimj = std::min(rows-_j, dim);
+
+                if (dimj <= 2)
+                    break;
+
+                windows.push_back(cv::Rect(_i, _j, dimi, dimj));
+
+                if ((_j + dim) >= rows)
+                    break;
+            }
+            if ((_i + dim) >= cols)
+                break;
+        }
+    }
+}
+
+/// Computes the descriptors of one image for `fl::extractPSBatch()`, as
+/// `fl::generatePSMerced()` does. Returns `false` if the image can not be read.
+/// With `approximate` the windows share one max-tree and min-tree of the whole image.
+bool extractImagePS(const std::string &path, bool entropy, const std::string &tiling, int startSize, bool approximate,
+                    int bins1, int scale1, int bins2, int max2, std::vector <float> &rows){
+    rows.clear();
+    cv::Mat img1 = cv::imread(path, cv::IMREAD_GRAYSCALE);
+    if (img1.empty())
+        return false;
+    cv::Mat img;
+    cv::equalizeHist(img1, img);
+
+    std::vector <std::vector <double> > descriptors;
+    if (tiling == "global"){
+        descriptors.push_back(std::vector<double>());
+        if (!entropy)
+            fl::globalPSDescriptor<fl::AreaAttribute, fl::NonCompactnessAttribute>(img, descriptors.back(), bins1, img.rows*img.cols, bins2, max2, scale1);
+        else
+            fl::globalPSDescriptor<fl::AreaAttribute, fl::EntropyAttribute>(img, descriptors.back(), bins1, img.rows*img.cols, bins2, max2, scale1);
+    }
+    else{
+        int pyramidFactor = (tiling == "tiled") ? std::max(img.cols, img.rows) : 2;
+        std::vector <cv::Rect> windows;
+        tilingWindows(img.rows, img.cols, startSize, pyramidFactor, windows);
+        if (approximate){
+            if (!entropy)
+                fl::localPSDescriptors<fl::NonCompactnessAttribute>(img, windows, descriptors, bins1, bins2, max2, scale1);
+            else
+                fl::localPSDescriptors<fl::EntropyAttribute>(img, windows, descriptors, bins1, bins2, max2, scale1);
+        }
+        else{
+            for (int w=0, szw = windows.size(); w < szw; ++w){
+                cv::Mat patch = img(windows[w]);
+                descriptors.push_back(std::vector<double>());
+                if (!entropy)
+                    fl::globalPSDescriptor<fl::AreaAttribute, fl::NonCompactnessAttribute>(patch, descriptors.back(), bins1, patch.rows*patch.cols, bins2, max2, scale1);
+                else
+                    fl::globalPSDescriptor<fl::AreaAttribute, fl::EntropyAttribute>(patch, descriptors.back(), bins1, patch.rows*patch.cols, bins2, max2, scale1);
+            }
+        }
+    }
+
+    for (int i=0, szi = descriptors.size(); i < szi; ++i)
+        rows.insert(rows.end(), descriptors[i].begin(), descriptors[i].end());
+    return true;
+}
+
+void evaluateDescriptors(const cv::Mat &descriptors, int zeroPerc){
+    int i = descriptors.rows;
+    int descriptorLength = descriptors.cols;
+
+    std::cout << "Empty bins (0.0): " << ((double)(zeroPerc*100))/(descriptorLength*i) << "%" << std::endl;
+
+    // full ranking of all the images; fl::DescriptorDistance::L2 or chiSquare to compare differently
+    std::vector <std::vector <fl::Neighbour> > neighbours;
+    fl::nearestNeighbours(descriptors, descriptors, i, fl::DescriptorDistance::L1, neighbours);
+
+    double anmrr = 0.0;
+    double mAP = 0.0;
+    std::vector<char> responses;
+    for (int j=0; j < i; ++j){ // go over every image
+        responses.clear(); responses.resize(i);
+
+        for (int k=0; k < i; ++k){
+            responses[k] = (char)((neighbours[j][k].second / 100)==(j/100));
+        }
+
+        double mynmrr = nmrr(responses, 100, 200);
+        double ap = averagePrecision(responses);
+        std::cout << "Average precision for image " << j << ": " << ap << std::endl;
+        anmrr += (mynmrr / i);
+        mAP += (ap / i);
+    }
+
+    std::cout << "ANMRR with K = 200 "  << anmrr << std::endl; // " " << anmrr2 << std::endl;
+    std::cout << "mAP " << mAP << std::endl;
+    return;
+
+}
+
+/// The ANMRR and the mAP (over the first K responses) of the Merced retrieval
+/// (100 images per class) from the K nearest neighbours of every image.
+void retrievalScores(const std::vector <std::vector <fl::Neighbour> > &neighbours, int K, double &anmrr, double &mAP){
+    anmrr = mAP = 0.0;
+    int n = neighbours.size();
+    std::vector<char> responses;
+    for (int j=0; j < n; ++j){
+        responses.assign(K, 0);
+        for (int k=0, szk = std::min(K, (int)neighbours[j].size()); k < szk; ++k)
+            responses[k] = (char)((neighbours[j][k].second / 100)==(j/100));
+        anmrr += nmrr(responses, 100, K) / n;
+        if (std::count(responses.begin(), responses.end(), 1))
+            mAP += averagePrecision(responses) / n;
+    }
+}
+
+/// The first descriptor of every image in a descriptor file, as a matrix.
+/// Shares the memory of the file if every image has exactly one descriptor.
+cv::Mat firstDescriptors(const fl::DescriptorFile &descFile, int &zeroPerc){
+    int n = descFile.imageCount(), len = descFile.rowLength();
+    cv::Mat descriptors;
+    if (descFile.rowCount() == n)
+        descriptors = descFile.descriptors();
+    else{
+        descriptors = cv::Mat::zeros(n, len, CV_32F);
+        for (int i=0; i < n; ++i)
+            if (descFile.imageRowCount(i))
+                std::copy(descFile.row(descFile.imageFirstRow(i)), descFile.row(descFile.imageFirstRow(i)) + len, descriptors.ptr<float>(i));
+    }
+    zeroPerc = 0;
+    for (int i=0; i < n; ++i)
+        for (int j=0; j < len; ++j)
+            zeroPerc += (int)(descriptors.ptr<float>(i)[j]==0);
+    return descriptors;
+}
+
 /*********************** MAIN FUNCTIONS OF THE EXAMPLE *************************/
 
 void fl::generatePSMerced(int argc, char** argv){
-    std::string goodFormat = "Expecting the call formatted as: ./Trees [listOfFiles] atr1=[area] bins1=[number] scale1=[-1 or size] atr2=[cnc,entropy] bins2=[number] max2=[number] tiling=[global,tiled,pyramid] [startSize (only for tiling=tiled,pyramid)]=[number]";
+    std::string goodFormat = "Expecting the call formatted as: ./Trees [listOfFiles] atr1=[area] bins1=[number] scale1=[-1 or size] atr2=[cnc,entropy] bins2=[number] max2=[number] tiling=[global,tiled,pyramid] [startSize (only for tiling=tiled,pyramid)]=[number] [windows (optional, only for tiling=tiled,pyramid)]=[exact,approx]";
     if (argc < 9){
         std::cerr << "FAIL: " << goodFormat << std::endl;
         return;
@@ -104,6 +248,7 @@ void fl::generatePSMerced(int argc, char** argv){
     sscanf(argv[7], "%d", &max2);
 
     int startSize = -1;
+    bool approximate = false;
     if (std::string(argv[8]) != "global"){
         if (argc < 10){
             std::cerr << "FAIL: " << goodFormat << std::endl;
@@ -112,6 +257,13 @@ void fl::generatePSMerced(int argc, char** argv){
         else{
             sscanf(argv[9], "%d", &startSize);
         }
+        if (argc > 10){
+            if (std::string(argv[10]) != "exact" && std::string(argv[10]) != "approx"){
+                std::cerr << "FAIL: " << goodFormat << std::endl;
+                return;
+            }
+            approximate = (std::string(argv[10]) == "approx");
+        }
     }
 
     int descriptorLength = bins1*bins2*2;
@@ -169,38 +321,25 @@ void fl::generatePSMerced(int argc, char** argv){
 
             descOut << descNum << std::endl;
 
-            for (int dim = startSize, offset = 16; dim < std::min(256,std::max(cols, rows))+2; dim *= pyramidFactor){
-                int sum = 0;
-                for (int _i=0; !_i || (_i - offset + dim < cols-2); _i += offset){
-                    int dimi = std::min(cols-_i, dim);
-                    if (dimi <= 2)
-                        break;
-                    for (int _j=0; !_j || (_j - offset + dim < rows-2); _j += offset){
-                        int dimj = std::min(rows-_j, dim);
-
-                        if (dimj <= 2)
-                            break;
-
-                        cv::Mat patch = img(cv::Rect(_i, _j, dimi, dimj));
-
-                        if (std::string(argv[5]) == "cnc")
-                            outputGlobalPS<fl::AreaAttribute, fl::NonCompactnessAttribute>(patch, descOut, bins1, patch.rows*patch.cols, bins2, max2, scale1);
-                        else
-                            outputGlobalPS<fl::AreaAttribute, fl::EntropyAttribute>(patch, descOut, bins1, patch.rows*patch.cols, bins2, max2, scale1);
-
-                        ++sum;
-
-                        if ((_j + dim) >= rows)
-                            break;
-                    }
-                    if ((_i + dim) >= cols)
-                        break;
+            std::vector <cv::Rect> windows;
+            tilingWindows(rows, cols, startSize, pyramidFactor, windows);
+
+            if (approximate){
+                // the trees are built once, for all the windows
+                if (std::string(argv[5]) == "cnc")
+                    outputLocalPS<fl::NonCompactnessAttribute>(img, windows, descOut, bins1, bins2, max2, scale1);
+                else
+                    outputLocalPS<fl::EntropyAttribute>(img, windows, descOut, bins1, bins2, max2, scale1);
+            }
+            else{
+                for (int w=0, szw = windows.size(); w < szw; ++w){
+                    cv::Mat patch = img(windows[w]);
+
+                    if (std::string(argv[5]) == "cnc")
+                        outputGlobalPS<fl::AreaAttribute, fl::NonCompactnessAttribute>(patch, descOut, bins1, patch.rows*patch.cols, bins2, max2, scale1);
+                    else
+                        outputGlobalPS<fl::AreaAttribute, fl::EntropyAttribute>(patch, descOut, bins1, patch.rows*patch.cols, bins2, max2, scale1);
                 }
-//                if (dim == 32){
-//                    std::ofstream toErase((removeExtension(line)+".32er").c_str());
-//                    toErase << sum << std::endl;
-//                    toErase.close();
-//                }
             }
 
             descOut.close();
@@ -209,8 +348,106 @@ void fl::generatePSMerced(int argc, char** argv){
     }
 }
 
+void fl::extractPSBatch(int argc, char** argv){
+    std::string goodFormat = "Expecting the call formatted as: ./Trees [listOfFiles] [outputFile] atr1=[area] bins1=[number] scale1=[-1 or size] atr2=[cnc,entropy] bins2=[number] max2=[number] tiling=[global,tiled,pyramid] [startSize (only for tiling=tiled,pyramid)]=[number] [windows (optional, only for tiling=tiled,pyramid)]=[exact,approx]";
+    if (argc < 10){
+        std::cerr << "FAIL: " << goodFormat << std::endl;
+        return;
+    }
+
+    std::ifstream listFile(argv[1]);
+
+    std::cout << "Reading the list of input files from: " << argv[1] << std::endl;
+
+    std::string tiling(argv[9]);
+    if (!listFile.is_open() ||
+        std::string(argv[3]) != "area" ||
+        (std::string(argv[6]) != "cnc" &&
+         std::string(argv[6]) != "entropy") ||
+        (tiling != "global" && tiling != "tiled" && tiling != "pyramid")){
+        std::cerr << "FAIL: " << goodFormat << std::endl;
+        return;
+    }
+    bool entropy = (std::string(argv[6]) == "entropy");
+
+    int bins1, bins2, scale1, max2;
+    sscanf(argv[4], "%d", &bins1);
+    sscanf(argv[7], "%d", &bins2);
+    sscanf(argv[5], "%d", &scale1);
+    sscanf(argv[8], "%d", &max2);
+
+    int startSize = -1;
+    bool approximate = false;
+    if (tiling != "global"){
+        if (argc < 11){
+            std::cerr << "FAIL: " << goodFormat << std::endl;
+            return;
+        }
+        sscanf(argv[10], "%d", &startSize);
+        if (argc > 11){
+            if (std::string(argv[11]) != "exact" && std::string(argv[11]) != "approx"){
+                std::cerr << "FAIL: " << goodFormat << std::endl;
+                return;
+            }
+            approximate = (std::string(argv[11]) == "approx");
+        }
+    }
+
+    std::vector <std::string> files;
+    std::string line;
+    while (std::getline(listFile, line))
+        files.push_back(line);
+
+    std::vector <int> layout;
+    layout.push_back(TREES); layout.push_back(bins1); layout.push_back(bins2);
+    fl::DescriptorFileWriter writer(argv[2], layout, bins1*bins2*TREES);
+    if (!writer.isOpen()){
+        std::cerr << "FAIL: Can not write to the output file " << argv[2] << std::endl;
+        return;
+    }
+
+    std::cout << "Writing the descriptors of " << files.size() << " images to: " << argv[2] << std::endl;
+
+    std::mutex logLock;
+    auto process = [&](int begin, int end){
+        std::vector <float> rows;
+        for (int i=begin; i < end; ++i){
+            bool success = extractImagePS(files[i], entropy, tiling, startSize, approximate, bins1, scale1, bins2, max2, rows);
+            writer.addImage(i, files[i], rows);
+
+            std::lock_guard <std::mutex> guard(logLock);
+            if (success)
+                std::cout << "processed: " << files[i] << std::endl;
+            else
+                std::cerr << "FAIL: Can not read " << files[i] << ", no descriptors written." << std::endl;
+        }
+    };
+
+    fl::detail::parallelFor(files.size(), process, 1);
+
+    if (!writer.close())
+        std::cerr << "FAIL: Error while writing to " << argv[2] << std::endl;
+}
+
 void fl::evaluateMerced(int argc, char** argv){
-    std::string goodFormat = "Expecting the call formatted as: ./Trees [listOfFiles] bins1=[number] bins2=[number] tiling=[global,tiled,pyramid]";
+    std::string goodFormat = "Expecting the call formatted as: ./Trees [listOfFiles] bins1=[number] bins2=[number] tiling=[global,tiled,pyramid]\n"
+                             "                               or: ./Trees [descriptorFile]";
+
+    int zeroPerc=0;
+
+    if (argc >= 2 && fl::DescriptorFile::isDescriptorFile(argv[1])){
+        fl::DescriptorFile descFile(argv[1]);
+        if (!descFile.isOpen()){
+            std::cerr << "FAIL: Invalid descriptor file " << argv[1] << std::endl;
+            return;
+        }
+        std::cout << "Reading the descriptors from: " << argv[1] << std::endl;
+
+        cv::Mat descriptors = firstDescriptors(descFile, zeroPerc);
+        evaluateDescriptors(descriptors, zeroPerc);
+        return;
+    }
+
     if (argc < 5){
         std::cerr << "FAIL: " << goodFormat << std::endl;
         return;
@@ -235,7 +472,6 @@ void fl::evaluateMerced(int argc, char** argv){
 
     std::string line;
     int i = 0;
-    int zeroPerc=0;
     while (std::getline(listFile, line)){
         ++i;
 
@@ -255,49 +491,79 @@ void fl::evaluateMerced(int argc, char** argv){
         }
     }
 
-    std::cout << "Empty bins (0.0): " << ((double)(zeroPerc*100))/(descriptorLength*i) << "%" << std::endl;
-
-    double anmrr = 0.0;
-    double mAP = 0.0;
-    std::vector<std::pair<double, int> > dists(i,std::make_pair(0,-1.0));
-    std::vector<char> responses;
-    for (int j=0; j < i; ++j){ // go over every image
-        dists.clear(); dists.resize(i,std::make_pair(0,-1.0));
-        for (int k=0; k < i; ++k){
-            dists[k].second = k;
-            for (int index=0; index < descriptorLength; ++index){
-                // L1:
-                dists[k].first += std::abs(descriptors[j][index] - descriptors[k][index]);
-                // L2:
-                // dists[k].first += (descriptors[j][index] - descriptors[k][index])*(descriptors[j][index] - descriptors[k][index]);
-                // chi:
-//                if (descriptors[j][index] && descriptors[k][index])
-//                    dists[k].first += (descriptors[j][index] - descriptors[k][index])*(descriptors[j][index] - descriptors[k][index]) /
-//                                            (descriptors[j][index] + descriptors[k][index]);
-            }
-        }
-        std::sort(dists.begin(), dists.end());
+    cv::Mat descMat(i, descriptorLength, CV_32F);
+    for (int j=0; j < i; ++j)
+        std::copy(descriptors[j].begin(), descriptors[j].end(), descMat.ptr<float>(j));
+    evaluateDescriptors(descMat, zeroPerc);
+}
 
-        responses.clear(); responses.resize(i);
+void fl::benchmarkRetrieval(int argc, char** argv){
+    std::string goodFormat = "Expecting the call formatted as: ./Trees [descriptorFile] lists=[number (-1 for sqrt of the number of images)] K=[number] distance=[L1,L2,chi]";
+    if (argc < 5){
+        std::cerr << "FAIL: " << goodFormat << std::endl;
+        return;
+    }
 
-        for (int k=0; k < i; ++k){
-            responses[k] = (char)((dists[k].second / 100)==(j/100));
+    fl::DescriptorFile descFile(argv[1]);
+    int nLists, K;
+    sscanf(argv[2], "%d", &nLists);
+    sscanf(argv[3], "%d", &K);
+    std::string dist(argv[4]);
+    if (!descFile.isOpen() || K <= 0 || (dist != "L1" && dist != "L2" && dist != "chi")){
+        std::cerr << "FAIL: " << goodFormat << std::endl;
+        return;
+    }
+    fl::DescriptorDistance type = (dist == "L1") ? fl::DescriptorDistance::L1 :
+                                  (dist == "L2") ? fl::DescriptorDistance::L2 : fl::DescriptorDistance::chiSquare;
+
+    int zeroPerc;
+    cv::Mat descriptors = firstDescriptors(descFile, zeroPerc);
+    int n = descriptors.rows;
+    if (nLists <= 0)
+        nLists = std::max(1, (int)std::sqrt((double)n));
+
+    double anmrr, mAP;
+    std::vector <std::vector <fl::Neighbour> > exact, approximate;
+
+    double t = (double)cv::getTickCount();
+    fl::nearestNeighbours(descriptors, descriptors, K, type, exact);
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    retrievalScores(exact, K, anmrr, mAP);
+    std::cout << n << " images, exhaustive search: " << 1000.0 * t / n << " ms per query, ANMRR with K = " << K << " "
+              << anmrr << ", mAP of the first " << K << " " << mAP << std::endl;
+
+    t = (double)cv::getTickCount();
+    fl::IVFIndex index(descriptors, nLists, type);
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    std::cout << "IVF index with " << index.listCount() << " lists built in " << t << " s" << std::endl;
+
+    for (int nProbe = 1; ; nProbe = std::min(2*nProbe, index.listCount())){
+        t = (double)cv::getTickCount();
+        index.search(descriptors, K, nProbe, approximate);
+        t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+        retrievalScores(approximate, K, anmrr, mAP);
+
+        // recall of the exact K nearest neighbours
+        double recall = 0;
+        std::vector <int> found;
+        for (int j=0; j < n; ++j){
+            found.clear();
+            for (int k=0, szk = approximate[j].size(); k < szk; ++k)
+                found.push_back(approximate[j][k].second);
+            std::sort(found.begin(), found.end());
+            int hits = 0;
+            for (int k=0, szk = exact[j].size(); k < szk; ++k)
+                hits += (int)std::binary_search(found.begin(), found.end(), exact[j][k].second);
+            recall += (exact[j].empty() ? 1.0 : (double)hits / exact[j].size()) / n;
         }
 
-        double mynmrr = nmrr(responses, 100, 200);
-        double ap = averagePrecision(responses);
-        std::cout << "Average precision for image " << j << ": " << ap << std::endl;
-        anmrr += (mynmrr / i);
-        mAP += (ap / i);
+        std::cout << "nProbe " << nProbe << ": " << 1000.0 * t / n << " ms per query, recall " << recall
+                  << ", ANMRR " << anmrr << ", mAP " << mAP << std::endl;
+        if (nProbe == index.listCount())
+            break;
     }
-
-    std::cout << "ANMRR with K = 200 "  << anmrr << std::endl; // " " << anmrr2 << std::endl;
-    std::cout << "mAP " << mAP << std::endl;
-    return;
-
 }
 
-
 void fl::visualizePS(const std::vector<std::vector<double> > ps){
     int cell = 50;
     cv::Mat output = cv::Mat::zeros(ps.size()*cell, ps.back().size()*cell, CV_8U);
@@ -23,20 +23,59 @@ namespace fl{
 
     /**
     \brief Generates the Pattern Spectra for the Merced data (or any other list of images).
+    \note By default every window gets the Pattern Spectra of its own trees. The optional
+          `approx` argument computes all windows from the trees of the whole image instead
+          (`outputLocalPS()`), which is faster, but gives approximate values.
     **/
     void generatePSMerced(int argc, char** argv);
 
+    /**
+    \brief Generates the Pattern Spectra for a list of images in parallel, and writes them
+           into a single binary descriptor file (read with `fl::DescriptorFile`).
+    \note The windows are computed exactly, or with `approx` approximately, as in `generatePSMerced()`.
+    **/
+    void extractPSBatch(int argc, char** argv);
+
     /**
     \brief Evaluates the retrieval with Pattern Spectra for the Merced data.
-    \note The list file assumes the files are listed in order of classes, 100 files per
-          class. Therefore this will only work for Merced (or some other dataset with 100
-          files per class.
+    \note The list file (or the descriptor file written by `extractPSBatch()`) assumes the
+          files are listed in order of classes, 100 files per class. Therefore this will only
+          work for Merced (or some other dataset with 100 files per class.
     **/
     void evaluateMerced(int argc, char** argv);
 
+    /**
+    \brief Compares the approximate retrieval with `fl::IVFIndex` to the exhaustive search,
+           for the descriptors in a file written by `extractPSBatch()`.
+    \note Reports the time per query, the recall of the K nearest neighbours, and the ANMRR
+          and mAP as `evaluateMerced()` (100 files per class).
+    **/
+    void benchmarkRetrieval(int argc, char** argv);
+
     template <typename SizeAttribute, typename ShapeAttribute>
     void outputGlobalPS(cv::Mat &image, std::ostream &outPS, int sizeBins = GAREA, int sizeMax = 150000, int shapeBins = GSHAPE, int shapeMax = GNC, int sizeScale = -1);
 
+    /**
+    \brief Computes the global Pattern Spectra descriptor of an image (of the max-tree, followed
+           by the min-tree), as output by `outputGlobalPS()`.
+    **/
+    template <typename SizeAttribute, typename ShapeAttribute>
+    void globalPSDescriptor(cv::Mat &image, std::vector<double> &descriptor, int sizeBins = GAREA, int sizeMax = 150000, int shapeBins = GSHAPE, int shapeMax = GNC, int sizeScale = -1);
+
+    /**
+    \brief Computes the Pattern Spectra descriptors of a set of windows of an image, as output
+           by `outputLocalPS()`.
+    **/
+    template <typename ShapeAttribute>
+    void localPSDescriptors(cv::Mat &image, const std::vector<cv::Rect> &windows, std::vector<std::vector<double> > &descriptors, int sizeBins = GAREA, int shapeBins = GSHAPE, int shapeMax = GNC, int sizeScale = -1);
+
+    /**
+    \brief Outputs the Pattern Spectra of a set of windows of an image, building the max-tree
+           and the min-tree only once for the whole image.
+    **/
+    template <typename ShapeAttribute>
+    void outputLocalPS(cv::Mat &image, const std::vector<cv::Rect> &windows, std::ostream &outPS, int sizeBins = GAREA, int shapeBins = GSHAPE, int shapeMax = GNC, int sizeScale = -1);
+
     void visualizePS(const std::vector<std::vector<double> > ps);
 }
 
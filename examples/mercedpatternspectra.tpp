@@ -21,9 +21,20 @@
 #include "../structures/noncompactnessattribute.h"
 #include "../structures/entropyattribute.h"
 #include "../structures/patternspectra2d.h"
+#include "../structures/treepatternspectra.h"
 
 template <typename SizeAttribute, typename ShapeAttribute>
 void fl::outputGlobalPS(cv::Mat &image, std::ostream &outPS, int sizeBins, int sizeMax, int shapeBins, int shapeMax, int sizeScale){
+        std::vector <double> descriptor;
+        globalPSDescriptor<SizeAttribute, ShapeAttribute>(image, descriptor, sizeBins, sizeMax, shapeBins, shapeMax, sizeScale);
+        for (int i=0, szi = descriptor.size(); i < szi; ++i)
+            outPS << descriptor[i] << " ";
+        outPS << std::endl;
+}
+
+template <typename SizeAttribute, typename ShapeAttribute>
+void fl::globalPSDescriptor(cv::Mat &image, std::vector<double> &descriptor, int sizeBins, int sizeMax, int shapeBins, int shapeMax, int sizeScale){
+        descriptor.clear();
         {
             fl::ImageTree *maxTree = new fl::ImageTree(fl::maxTreeNister(image, std::greater<int>()), // max-tree
                                                         std::make_pair(image.rows, image.cols));
@@ -31,32 +42,33 @@ void fl::outputGlobalPS(cv::Mat &image, std::ostream &outPS, int sizeBins, int s
             maxTree->addAttributeToTree<SizeAttribute>(getSettingsForAttributeType<SizeAttribute>());
             maxTree->addAttributeToTree<ShapeAttribute>(getSettingsForAttributeType<ShapeAttribute>());
 
+            fl::PatternSpectra2DSettings *settings;
             if (sizeScale > 0){
-                maxTree->addPatternSpectra2DToTree<SizeAttribute, ShapeAttribute>
-                    (new fl::PatternSpectra2DSettings(fl::Binning(sizeBins,  1, sizeMax, fl::Binning::Scale::logarithmic, sizeScale),
-                                                      fl::Binning(shapeBins, 1, shapeMax, fl::Binning::Scale::logarithmic), true, true, true));
+                settings = new fl::PatternSpectra2DSettings(fl::Binning(sizeBins,  1, sizeMax, fl::Binning::Scale::logarithmic, sizeScale),
+                                                            fl::Binning(shapeBins, 1, shapeMax, fl::Binning::Scale::logarithmic), true, true, true);
             }
             else{
-                maxTree->addPatternSpectra2DToTree<SizeAttribute, ShapeAttribute>
-                    (new fl::PatternSpectra2DSettings(fl::Binning(sizeBins,  1, sizeMax, fl::Binning::Scale::logarithmic),
-                                                      fl::Binning(shapeBins, 1, shapeMax, fl::Binning::Scale::logarithmic), true, true, true));
+                settings = new fl::PatternSpectra2DSettings(fl::Binning(sizeBins,  1, sizeMax, fl::Binning::Scale::logarithmic),
+                                                            fl::Binning(shapeBins, 1, shapeMax, fl::Binning::Scale::logarithmic), true, true, true);
             }
 
-            const std::vector<std::vector<double> > &ps = maxTree->root()->getPatternSpectra2D(SizeAttribute::name+ShapeAttribute::name)->getPatternSpectraMatrix();
+            std::vector<double> ps;
+            maxTree->globalPatternSpectra2D<SizeAttribute, ShapeAttribute>(*settings, ps);
+            delete settings;
+            int dim2 = shapeBins + 2;
 
             std::vector<std::vector<double> >pps;
 
-            for (int j=1; j < (int)ps.size()-1; ++j){
+            for (int j=1; j < sizeBins+1; ++j){
                 pps.push_back(std::vector<double>());
-                for (int k=1; k < (int)ps[j].size()-1; ++k){
-                    outPS << std::pow(ps[j][k], 0.2) << " ";
-                    pps.back().push_back(std::pow(ps[j][k], 0.2)); // store the PS root
-                    // pps.back().push_back(ps[j][k]);          // store PS normally
+                for (int k=1; k < shapeBins+1; ++k){
+                    descriptor.push_back(std::pow(ps[j*dim2+k], 0.2));
+                    pps.back().push_back(std::pow(ps[j*dim2+k], 0.2)); // store the PS root
+                    // pps.back().push_back(ps[j*dim2+k]);          // store PS normally
                 }
             }
             //visualizePS(pps);
 
-            maxTree->deletePatternSpectra2DFromTree<SizeAttribute, ShapeAttribute>();
             maxTree->deleteAttributeFromTree<ShapeAttribute>();
             maxTree->deleteAttributeFromTree<SizeAttribute>();
 
@@ -71,40 +83,103 @@ void fl::outputGlobalPS(cv::Mat &image, std::ostream &outPS, int sizeBins, int s
             minTree->addAttributeToTree<SizeAttribute>(fl::getSettingsForAttributeType<SizeAttribute>());
             minTree->addAttributeToTree<ShapeAttribute>(fl::getSettingsForAttributeType<ShapeAttribute>());
 
+            fl::PatternSpectra2DSettings *settings;
             if (sizeScale > 0){
-                minTree->addPatternSpectra2DToTree<SizeAttribute, ShapeAttribute>
-                    (new fl::PatternSpectra2DSettings(fl::Binning(sizeBins,  1, sizeMax, fl::Binning::Scale::logarithmic, sizeScale),
-                                                      fl::Binning(shapeBins, 1, shapeMax, fl::Binning::Scale::logarithmic), true, true, true));
+                settings = new fl::PatternSpectra2DSettings(fl::Binning(sizeBins,  1, sizeMax, fl::Binning::Scale::logarithmic, sizeScale),
+                                                            fl::Binning(shapeBins, 1, shapeMax, fl::Binning::Scale::logarithmic), true, true, true);
             }
             else{
-                minTree->addPatternSpectra2DToTree<SizeAttribute, ShapeAttribute>
-                    (new fl::PatternSpectra2DSettings(fl::Binning(sizeBins,  1, sizeMax, fl::Binning::Scale::logarithmic),
-                                                      fl::Binning(shapeBins, 1, shapeMax, fl::Binning::Scale::logarithmic), true, true, true));
+                settings = new fl::PatternSpectra2DSettings(fl::Binning(sizeBins,  1, sizeMax, fl::Binning::Scale::logarithmic),
+                                                            fl::Binning(shapeBins, 1, shapeMax, fl::Binning::Scale::logarithmic), true, true, true);
             }
 
-            const std::vector<std::vector<double> > &ps = minTree->root()->getPatternSpectra2D(SizeAttribute::name+ShapeAttribute::name)->getPatternSpectraMatrix();
+            std::vector<double> ps;
+            minTree->globalPatternSpectra2D<SizeAttribute, ShapeAttribute>(*settings, ps);
+            delete settings;
+            int dim2 = shapeBins + 2;
 
             std::vector<std::vector<double> >pps;
 
-            for (int j=1; j < (int)ps.size()-1; ++j){
+            for (int j=1; j < sizeBins+1; ++j){
                 pps.push_back(std::vector<double>());
-                for (int k=1; k < (int)ps[j].size()-1; ++k){
-                    outPS << std::pow(ps[j][k], 0.2) << " ";
-                    pps.back().push_back(std::pow(ps[j][k], 0.2));
-                    //pps.back().push_back(ps[j][k]);
+                for (int k=1; k < shapeBins+1; ++k){
+                    descriptor.push_back(std::pow(ps[j*dim2+k], 0.2));
+                    pps.back().push_back(std::pow(ps[j*dim2+k], 0.2));
+                    //pps.back().push_back(ps[j*dim2+k]);
                 }
             }
 
             //visualizePS(pps);
-            minTree->deletePatternSpectra2DFromTree<SizeAttribute, ShapeAttribute>();
             minTree->deleteAttributeFromTree<ShapeAttribute>();
             minTree->deleteAttributeFromTree<SizeAttribute>();
 
             minTree->unsetImage();
             delete minTree;
         }
+}
 
-        outPS << std::endl;
+template <typename ShapeAttribute>
+void fl::outputLocalPS(cv::Mat &image, const std::vector<cv::Rect> &windows, std::ostream &outPS, int sizeBins, int shapeBins, int shapeMax, int sizeScale){
+        std::vector <std::vector <double> > descriptors;
+        localPSDescriptors<ShapeAttribute>(image, windows, descriptors, sizeBins, shapeBins, shapeMax, sizeScale);
+        for (int i=0, szi = descriptors.size(); i < szi; ++i){
+            for (int j=0, szj = descriptors[i].size(); j < szj; ++j)
+                outPS << descriptors[i][j] << " ";
+            outPS << std::endl;
+        }
+}
+
+template <typename ShapeAttribute>
+void fl::localPSDescriptors(cv::Mat &image, const std::vector<cv::Rect> &windows, std::vector<std::vector<double> > &descriptors, int sizeBins, int shapeBins, int shapeMax, int sizeScale){
+        // the size bins of every window are relative to the window area, as with a separate tree per window
+        fl::PatternSpectra2DSettings *settings;
+        if (sizeScale > 0){
+            settings = new fl::PatternSpectra2DSettings(fl::Binning(sizeBins,  1, NODE_VAL, fl::Binning::Scale::logarithmic, sizeScale),
+                                                        fl::Binning(shapeBins, 1, shapeMax, fl::Binning::Scale::logarithmic), false, true, true);
+        }
+        else{
+            settings = new fl::PatternSpectra2DSettings(fl::Binning(sizeBins,  1, NODE_VAL, fl::Binning::Scale::logarithmic),
+                                                        fl::Binning(shapeBins, 1, shapeMax, fl::Binning::Scale::logarithmic), false, true, true);
+        }
+
+        std::vector<std::vector<double> > maxPS, minPS;
+        {
+            fl::ImageTree *maxTree = new fl::ImageTree(fl::maxTreeNister(image, std::greater<int>()), // max-tree
+                                                        std::make_pair(image.rows, image.cols));
+            maxTree->setImage(image);
+            maxTree->addAttributeToTree<ShapeAttribute>(getSettingsForAttributeType<ShapeAttribute>());
+
+            maxTree->localPatternSpectra2D<ShapeAttribute>(windows, *settings, maxPS);
+
+            maxTree->deleteAttributeFromTree<ShapeAttribute>();
+            maxTree->unsetImage();
+            delete maxTree;
+        }
+        {
+            fl::ImageTree *minTree = new fl::ImageTree(fl::maxTreeNister(image, std::less<int>()), // min-tree
+                                                        std::make_pair(image.rows, image.cols));
+            minTree->setImage(image);
+            minTree->addAttributeToTree<ShapeAttribute>(getSettingsForAttributeType<ShapeAttribute>());
+
+            minTree->localPatternSpectra2D<ShapeAttribute>(windows, *settings, minPS);
+
+            minTree->deleteAttributeFromTree<ShapeAttribute>();
+            minTree->unsetImage();
+            delete minTree;
+        }
+        delete settings;
+
+        int dim2 = shapeBins + 2;
+        descriptors.assign(windows.size(), std::vector<double>());
+        for (int i=0, szi = windows.size(); i < szi; ++i){
+            descriptors[i].reserve(2*sizeBins*shapeBins);
+            for (int j=1; j < sizeBins+1; ++j)
+                for (int k=1; k < shapeBins+1; ++k)
+                    descriptors[i].push_back(std::pow(maxPS[i][j*dim2+k], 0.2));
+            for (int j=1; j < sizeBins+1; ++j)
+                for (int k=1; k < shapeBins+1; ++k)
+                    descriptors[i].push_back(std::pow(minPS[i][j*dim2+k], 0.2));
+        }
 }
 
 
@@ -9,6 +9,7 @@
 
 #include <fstream>
 #include <numeric>
+#include <algorithm>
 #include <iostream>
 
 /// \brief Determine the output path for the granulometry based on
@@ -39,7 +40,14 @@ std::string outputFilePath(const std::string& imagePath, const int rule, const f
     return outputPath;
 }
 
-void rClassicalMorphology(int argc, char **argv){
+/// \brief Read the arguments shared by `rClassicalMorphology()` and `rTreeGranulometry()`:
+/// the image, and the sides of the square structuring elements for all the scales,
+/// which are printed.
+///
+/// \param image Output, the input image.
+/// \param limits Output, the sides of the structuring elements, increasing.
+/// \param binning Output, the name of the binning used in the output file names.
+static void readMorphologyArguments(int argc, char **argv, cv::Mat &image, std::vector <int> &limits, std::string &binning){
     std::string correctCall = "Call with following arguments: ./Trees [image_path] [operation: opening, closing, both] [filtering_rule: count, volume, both] [binning: log, arbitrary] [bins: [if log: number_of_bins upper_limit] [if arbitrary: bin limits]].";
     if (argc < 6){
         std::cerr << "Not enough arguments" << std::endl;
@@ -51,9 +59,8 @@ void rClassicalMorphology(int argc, char **argv){
         std::cerr << "Please provide a correct [image_path]." << std::endl;
         exit(1);
     }
-    cv::Mat image = cv::imread(argv[1], CV_LOAD_IMAGE_GRAYSCALE); // error catching for image input?
-    std::vector <int> limits;
-    std::string binning;
+    image = cv::imread(argv[1], CV_LOAD_IMAGE_GRAYSCALE); // error catching for image input?
+    limits.clear();
     if (std::string(argv[4]) == "log"){
         int numBins, upperLimit;
         if (argc < 7){
@@ -85,6 +92,13 @@ void rClassicalMorphology(int argc, char **argv){
     for (int i=0, szi = limits.size(); i < szi; ++i)
         std::cout << limits[i] << " ";
     std::cout  << std::endl;
+}
+
+void rClassicalMorphology(int argc, char **argv){
+    cv::Mat image;
+    std::vector <int> limits;
+    std::string binning;
+    readMorphologyArguments(argc, argv, image, limits, binning);
 
     //int volumeOriginal = detail::getImageVolume(image);
     //std::cout << "Original image volume: " << volumeOriginal << std::endl;
@@ -222,6 +236,77 @@ void rClassicalMorphology(int argc, char **argv){
     }
 }
 
+/// \brief Approximate the granulometry of `rClassicalMorphology()` from a single tree.
+///
+/// Takes the same arguments, and writes the files in the same format, with `_tree`
+/// added to their names. A single max-tree (min-tree) gives the curves for all the
+/// scales, but the operator is different: a region is removed as a whole at the
+/// scale `L` if the shorter side of its bounding box is smaller than `L` (an
+/// attribute opening or closing), while the opening by the square of side `L` only
+/// removes the parts of the region not covered by such a square.
+void rTreeGranulometry(int argc, char **argv){
+    cv::Mat image;
+    std::vector <int> limits;
+    std::string binning;
+    readMorphologyArguments(argc, argv, image, limits, binning);
+
+    std::vector <std::string> operations;
+    if (std::string(argv[2]) == "opening" || std::string(argv[2]) == "both")
+        operations.push_back("opening");
+    if (std::string(argv[2]) == "closing" || std::string(argv[2]) == "both")
+        operations.push_back("closing");
+
+    // a region of the max-tree (min-tree) is removed at the scale `limits[i]` if the
+    // shorter side of its bounding box is smaller than `limits[i]`
+    for (int o=0, szo = operations.size(); o < szo; ++o){
+        fl::ImageTree *tree = fl::createTree(operations[o] == "opening" ? fl::treeType::maxTree : fl::treeType::minTree, image);
+        std::vector <std::map<double, long long> > counts, volumes;
+        tree->sizeGranulometry(std::vector <fl::sizeMeasure>(1, fl::sizeMeasure::boxSide), counts, volumes);
+        delete tree;
+
+        std::vector <long long> volume(limits.size(), 0);
+        std::vector <long long> ccount(limits.size(), 0);
+        for (auto elem : counts[0]){
+            int bin = std::upper_bound(limits.begin(), limits.end(), (int)elem.first) - limits.begin();
+            if (bin < (int)limits.size())
+                ccount[bin] += elem.second;
+        }
+        for (auto elem : volumes[0]){
+            int bin = std::upper_bound(limits.begin(), limits.end(), (int)elem.first) - limits.begin();
+            if (bin < (int)limits.size())
+                volume[bin] += elem.second;
+        }
+        // number of regions removed up to each scale
+        std::partial_sum(ccount.begin(), ccount.end(), ccount.begin());
+
+        if (std::string(argv[3]) == "volume" || std::string(argv[3]) == "both"){
+            long long volumeSum = std::accumulate(volume.begin(), volume.end(), 0LL);
+            std::string output = removeExtension(argv[1]) + "_volume_" + operations[o] + "_tree_" + binning + "_text.txt";
+            std::ofstream volumeOut(output);
+
+            volumeOut << removeExtension(argv[1]) + "_volume_" + operations[o] + "_tree_" + std::string(argv[4]) << " " << limits.size() << " ";
+            for (int i=0, szi = limits.size(); i < szi; ++i)
+                volumeOut << (double)volume[i]/volumeSum << " ";
+            volumeOut << 1.0/volumeSum << std::endl;
+
+            volumeOut.close();
+        }
+
+        if (std::string(argv[3]) == "count" || std::string(argv[3]) == "both"){
+            long long countSum = std::accumulate(ccount.begin(), ccount.end(), 0LL);
+            std::string output = removeExtension(argv[1]) + "_count_" + operations[o] + "_tree_" + binning + "_text.txt";
+            std::ofstream countOut(output);
+
+            countOut << removeExtension(argv[1]) + "_count_" + operations[o] + "_tree_" + std::string(argv[4]) << " " << limits.size() << " ";
+            for (int i=0, szi = limits.size(); i < szi; ++i)
+                countOut << (double)ccount[i]/countSum << " ";
+            countOut << 1.0/countSum << std::endl;
+
+            countOut.close();
+        }
+    }
+}
+
 /// \brief Function to use for calculation of global (area) pattern spectra of a single image.
 ///
 /// Usage: call as the only function from `main`, passing the input arguments from `main`.
@@ -34,4 +34,7 @@ std::string outputFilePath(const std::string& imagePath, const int rule, const f
 
 void rClassicalMorphology(int argc, char **argv);
 
+/// \brief Approximate the granulometry of `rClassicalMorphology()` from a single tree.
+void rTreeGranulometry(int argc, char **argv);
+
 #endif
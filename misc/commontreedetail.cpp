@@ -1,6 +1,9 @@
 #include "commontreedetail.h"
 
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 
 namespace fl{
     int detail::maxTreeGrayLvlAssign::operator() (double myLvl, const std::vector <pxCoord> &/*ownElems*/, const std::vector<int> &/*chGL*/, const std::vector<int> &/*chSz*/) const{
@@ -206,4 +209,89 @@ namespace fl{
 //        std::partial_sum(data.begin(), data.end(), data.begin(),
 //            [](std::pair<double, int>& x, std::pair<double, int>& y){return std::make_pair(y.first, x.second + y.second);});
     }
+
+    /// \param sequence A sequence where the neighbouring elements differ by exactly 1.
+    detail::CompactRMQPlusMinusOne::CompactRMQPlusMinusOne(const std::vector <int> &sequence){
+        unsigned int n = sequence.size();
+        this->blockSize = (n > 1) ? std::ceil(std::log2((double)n) / 2) : 1;
+        this->blockSize = std::max(1u, std::min(16u, this->blockSize));
+        this->blockCount = (n + this->blockSize - 1) / this->blockSize;
+        unsigned int b = this->blockSize;
+
+        // the steps past the end of the sequence count as +1, never holding the minimum
+        this->blockFirst.resize(this->blockCount);
+        this->blockCode.assign(this->blockCount, 0);
+        for (unsigned int bl = 0; bl < this->blockCount; ++bl){
+            this->blockFirst[bl] = sequence[bl * b];
+            for (unsigned int o = 1; o < b; ++o){
+                unsigned int i = bl * b + o;
+                if (i < n && std::abs(sequence[i] - sequence[i-1]) != 1)
+                    throw "Invalid input sequence";
+                if (i >= n || sequence[i] > sequence[i-1])
+                    this->blockCode[bl] |= (1u << (o-1));
+            }
+        }
+
+        unsigned int codes = 1u << (b-1);
+        this->blockValue.resize((size_t)codes * b);
+        this->blockMin.assign((size_t)codes * b * b, 0);
+        for (unsigned int code = 0; code < codes; ++code){
+            int8_t *val = &this->blockValue[(size_t)code * b];
+            val[0] = 0;
+            for (unsigned int o = 1; o < b; ++o)
+                val[o] = val[o-1] + ((code >> (o-1)) & 1 ? 1 : -1);
+            for (unsigned int i = 0; i < b; ++i){
+                uint8_t *mins = &this->blockMin[((size_t)code * b + i) * b];
+                unsigned int cur = i;
+                for (unsigned int j = i; j < b; ++j){
+                    if (val[j] < val[cur])
+                        cur = j;
+                    mins[j] = cur;
+                }
+            }
+        }
+
+        this->logTable.assign(this->blockCount + 1, 0);
+        for (unsigned int len = 2; len <= this->blockCount; ++len)
+            this->logTable[len] = this->logTable[len / 2] + 1;
+        unsigned int levels = this->blockCount ? this->logTable[this->blockCount] + 1 : 0;
+        this->sparse.resize((size_t)levels * this->blockCount);
+        for (unsigned int bl = 0; bl < this->blockCount; ++bl)
+            this->sparse[bl] = this->inBlock(bl, 0, b-1);
+        for (unsigned int k = 1; k < levels; ++k){
+            const uint32_t *prev = &this->sparse[(size_t)(k-1) * this->blockCount];
+            uint32_t *cur = &this->sparse[(size_t)k * this->blockCount];
+            for (unsigned int bl = 0; bl + (1u << k) <= this->blockCount; ++bl){
+                uint32_t left = prev[bl], right = prev[bl + (1u << (k-1))];
+                cur[bl] = (this->value(right) < this->value(left)) ? right : left;
+            }
+        }
+    }
+
+    /// \param iStart Index of the start of the range.
+    /// \param iEnd Index of the end of the range.
+    unsigned int detail::CompactRMQPlusMinusOne::operator() (unsigned int iStart, unsigned int iEnd) const{
+        if (iEnd < iStart)
+            std::swap(iEnd, iStart);
+        unsigned int b = this->blockSize;
+        unsigned int bs = iStart / b, be = iEnd / b;
+        if (bs == be)
+            return this->inBlock(bs, iStart % b, iEnd % b);
+
+        unsigned int best = this->inBlock(bs, iStart % b, b-1);
+        if (be > bs + 1){
+            unsigned int first = bs + 1, last = be - 1;
+            unsigned int k = this->logTable[last - first + 1];
+            const uint32_t *level = &this->sparse[(size_t)k * this->blockCount];
+            unsigned int left = level[first], right = level[last - (1u << k) + 1];
+            if (this->value(left) < this->value(best))
+                best = left;
+            if (this->value(right) < this->value(best))
+                best = right;
+        }
+        unsigned int end = this->inBlock(be, 0, iEnd % b);
+        if (this->value(end) < this->value(best))
+            best = end;
+        return best;
+    }
 }
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <map>
+#include <cstdint>
 
 #include "pixels.h"
 
@@ -177,6 +178,53 @@ namespace fl{
                 static void codeToSequence(const unsigned int code, const unsigned int len, std::vector<T> &sequence);
         };
 
+        /// \class CompactRMQPlusMinusOne
+        ///
+        /// \brief A compact RMQ for +-1 sequences (e.g. the depths along an Euler tour),
+        /// with O(n) preprocessing time and O(1) query time.
+        ///
+        /// The sequence is cut into blocks of about log(n)/2 elements, each encoded by
+        /// the pattern of its +-1 steps. The in-block minima of every possible pattern
+        /// are stored in one flat table of byte offsets, and the minima of the blocks in a
+        /// sparse table of 32-bit indices. Unlike `RMQPlusMinusOne`, the sequence is not
+        /// needed after the construction.
+        class CompactRMQPlusMinusOne{
+            public:
+                /// \brief Constructor, preprocessing \p sequence.
+                CompactRMQPlusMinusOne(const std::vector <int> &sequence);
+
+                /// \brief The index of the minimal element in the range [\p iStart, \p iEnd]
+                /// (or [\p iEnd, \p iStart]).
+                unsigned int operator() (unsigned int iStart, unsigned int iEnd) const;
+
+            private:
+                unsigned int blockSize;
+                unsigned int blockCount;
+                std::vector <int> blockFirst;
+                std::vector <uint16_t> blockCode;
+
+                /// \brief `blockValue[code*blockSize + o]`: the value at the offset `o`
+                /// relative to the first value of a block.
+                std::vector <int8_t> blockValue;
+                /// \brief `blockMin[(code*blockSize + i)*blockSize + j]`: the offset of the
+                /// minimum in the range [i, j] of a block.
+                std::vector <uint8_t> blockMin;
+
+                /// \brief `sparse[k*blockCount + b]`: the index of the minimum of the blocks
+                /// [b, b + 2^k).
+                std::vector <uint32_t> sparse;
+                std::vector <uint8_t> logTable;
+
+                int value(unsigned int i) const{
+                    unsigned int b = i / this->blockSize;
+                    return this->blockFirst[b] + this->blockValue[this->blockCode[b] * this->blockSize + i % this->blockSize];
+                }
+
+                unsigned int inBlock(unsigned int b, unsigned int i, unsigned int j) const{
+                    return b * this->blockSize + this->blockMin[(this->blockCode[b] * this->blockSize + i) * this->blockSize + j];
+                }
+        };
+
 
 
     }
@@ -0,0 +1,253 @@
+/// \file misc/descriptorfile.cpp
+/// \author Petra Bosilj
+
+#include "descriptorfile.h"
+
+#include <iostream>
+#include <iterator>
+#include <cstring>
+#include <cstdlib>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define DESCRIPTOR_FILE_MMAP
+#endif
+
+/// The first bytes of every descriptor file.
+static const char descriptorMagic[8] = {'F', 'L', 'D', 'E', 'S', 'C', 'R', '\0'};
+
+/// The rows are aligned to this many bytes in the file (and in the memory it is mapped to).
+#define DESCRIPTOR_ROW_ALIGN 64
+
+/// \param path The path of the file to create.
+/// \param layout The bin layout of the descriptors, at most `DESCRIPTOR_MAX_DIMS` values.
+/// The product of \p layout is expected to be \p rowLength.
+/// \param rowLength The length of every descriptor.
+fl::DescriptorFileWriter::DescriptorFileWriter(const std::string &path, const std::vector <int> &layout, int rowLength)
+    : out(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc), nextImage(0){
+    if ((int)layout.size() > DESCRIPTOR_MAX_DIMS){
+        std::cerr << "The bin layout of a descriptor file can have at most " << DESCRIPTOR_MAX_DIMS << " dimensions." << std::endl;
+        std::exit(-1);
+    }
+
+    std::memset(&this->header, 0, sizeof(this->header));
+    std::memcpy(this->header.magic, descriptorMagic, sizeof(descriptorMagic));
+    this->header.version = 1;
+    this->header.layoutDims = layout.size();
+    for (int i=0, szi = layout.size(); i < szi; ++i)
+        this->header.layout[i] = layout[i];
+    this->header.rowLength = rowLength;
+    this->header.rowsOffset = (sizeof(DescriptorFileHeader) + DESCRIPTOR_ROW_ALIGN - 1) / DESCRIPTOR_ROW_ALIGN * DESCRIPTOR_ROW_ALIGN;
+
+    // the header is rewritten by close()
+    std::vector <char> placeholder(this->header.rowsOffset, 0);
+    this->out.write(&placeholder[0], placeholder.size());
+}
+
+fl::DescriptorFileWriter::~DescriptorFileWriter(){
+    this->close();
+}
+
+bool fl::DescriptorFileWriter::isOpen() const{
+    return this->out.is_open() && this->out.good();
+}
+
+/// Thread-safe. An image is written as soon as all the images with smaller numbers
+/// were added, until then it is kept in memory.
+///
+/// \param image The number of the image (from 0, every number used once).
+/// \param name The name of the image (e.g. the path).
+/// \param rows The descriptors of the image, `rowLength` values each.
+void fl::DescriptorFileWriter::addImage(int image, const std::string &name, const std::vector <float> &rows){
+    std::lock_guard <std::mutex> guard(this->lock);
+    if (image != this->nextImage){
+        this->pending[image] = std::make_pair(name, rows);
+        return;
+    }
+    this->writeImage(name, rows);
+    ++this->nextImage;
+
+    std::map <int, std::pair <std::string, std::vector <float> > >::iterator it;
+    while (!this->pending.empty() && (it = this->pending.begin())->first == this->nextImage){
+        this->writeImage(it->second.first, it->second.second);
+        this->pending.erase(it);
+        ++this->nextImage;
+    }
+}
+
+void fl::DescriptorFileWriter::writeImage(const std::string &name, const std::vector <float> &rows){
+    DescriptorFileEntry entry;
+    entry.firstRow = this->header.rowCount;
+    entry.rowCount = this->header.rowLength ? rows.size() / this->header.rowLength : 0;
+    entry.nameOffset = this->names.size();
+    this->index.push_back(entry);
+
+    this->names.append(name.c_str(), name.size() + 1);
+    if (entry.rowCount)
+        this->out.write((const char *)&rows[0], entry.rowCount * this->header.rowLength * sizeof(float));
+    this->header.rowCount += entry.rowCount;
+}
+
+/// The images still waiting for an image with a smaller number (which was never
+/// added) are written in order of their numbers.
+///
+/// \return `true` if the whole file was written successfully.
+bool fl::DescriptorFileWriter::close(){
+    std::lock_guard <std::mutex> guard(this->lock);
+    if (!this->out.is_open())
+        return false;
+
+    for (std::map <int, std::pair <std::string, std::vector <float> > >::iterator it = this->pending.begin(); it != this->pending.end(); ++it)
+        this->writeImage(it->second.first, it->second.second);
+    this->pending.clear();
+
+    this->header.imageCount = this->index.size();
+    uint64_t rowsEnd = this->header.rowsOffset + this->header.rowCount * this->header.rowLength * sizeof(float);
+    this->header.indexOffset = (rowsEnd + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    this->header.namesOffset = this->header.indexOffset + this->index.size() * sizeof(DescriptorFileEntry);
+    this->header.fileSize = this->header.namesOffset + this->names.size();
+
+    const char padding[sizeof(uint64_t)] = {0};
+    this->out.write(padding, this->header.indexOffset - rowsEnd);
+    if (!this->index.empty())
+        this->out.write((const char *)&this->index[0], this->index.size() * sizeof(DescriptorFileEntry));
+    this->out.write(this->names.data(), this->names.size());
+    this->out.seekp(0);
+    this->out.write((const char *)&this->header, sizeof(this->header));
+
+    bool success = this->out.good();
+    this->out.close();
+    return success;
+}
+
+fl::DescriptorFile::DescriptorFile()
+    : data(NULL), size(0), mapped(false), header(NULL), index(NULL) {}
+
+/// \param path The path of the file to open.
+fl::DescriptorFile::DescriptorFile(const std::string &path)
+    : data(NULL), size(0), mapped(false), header(NULL), index(NULL) {
+    this->open(path);
+}
+
+fl::DescriptorFile::~DescriptorFile(){
+    this->close();
+}
+
+/// Where memory mapping is not available, the file is read into memory.
+///
+/// \param path The path of the file to open.
+///
+/// \return `true` if \p path was opened and is a valid descriptor file.
+bool fl::DescriptorFile::open(const std::string &path){
+    this->close();
+
+#ifdef DESCRIPTOR_FILE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0){
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED){
+            this->data = (const char *)addr;
+            this->size = st.st_size;
+            this->mapped = true;
+        }
+    }
+    ::close(fd);
+#endif
+
+    if (!this->mapped){
+        std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+        if (!in.is_open())
+            return false;
+        this->buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        this->data = this->buffer.empty() ? NULL : &this->buffer[0];
+        this->size = this->buffer.size();
+    }
+
+    this->header = (const DescriptorFileHeader *)this->data;
+    if (!this->validate()){
+        this->close();
+        return false;
+    }
+    this->index = (const DescriptorFileEntry *)(this->data + this->header->indexOffset);
+    return true;
+}
+
+void fl::DescriptorFile::close(){
+#ifdef DESCRIPTOR_FILE_MMAP
+    if (this->mapped)
+        munmap((void *)this->data, this->size);
+#endif
+    std::vector <char>().swap(this->buffer);
+    this->data = NULL;
+    this->size = 0;
+    this->mapped = false;
+    this->header = NULL;
+    this->index = NULL;
+}
+
+bool fl::DescriptorFile::isOpen() const{
+    return this->header != NULL;
+}
+
+/// \param path The path of the file to check.
+bool fl::DescriptorFile::isDescriptorFile(const std::string &path){
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+    char magic[sizeof(descriptorMagic)];
+    return in.read(magic, sizeof(magic)) && !std::memcmp(magic, descriptorMagic, sizeof(magic));
+}
+
+bool fl::DescriptorFile::validate() const{
+    if (this->size < sizeof(DescriptorFileHeader) || std::memcmp(this->header->magic, descriptorMagic, sizeof(descriptorMagic)))
+        return false;
+    const DescriptorFileHeader &h = *this->header;
+    return h.version == 1 && h.layoutDims <= DESCRIPTOR_MAX_DIMS && h.fileSize == this->size &&
+           h.indexOffset >= h.rowsOffset + h.rowCount * h.rowLength * sizeof(float) &&
+           h.indexOffset % sizeof(uint64_t) == 0 &&
+           h.namesOffset == h.indexOffset + h.imageCount * sizeof(DescriptorFileEntry) &&
+           h.namesOffset <= h.fileSize;
+}
+
+std::vector <int> fl::DescriptorFile::layout() const{
+    return std::vector <int>(this->header->layout, this->header->layout + this->header->layoutDims);
+}
+
+int fl::DescriptorFile::rowLength() const { return this->header->rowLength; }
+
+int fl::DescriptorFile::rowCount() const { return this->header->rowCount; }
+
+int fl::DescriptorFile::imageCount() const { return this->header->imageCount; }
+
+/// \param i The index of the descriptor.
+const float *fl::DescriptorFile::row(int i) const{
+    return (const float *)(this->data + this->header->rowsOffset) + (size_t)i * this->header->rowLength;
+}
+
+/// \return A `rowCount()` x `rowLength()` matrix of type `CV_32F` sharing the
+/// memory of the file. Must not be written to.
+cv::Mat fl::DescriptorFile::descriptors() const{
+    return cv::Mat(this->rowCount(), this->rowLength(), CV_32F, (void *)this->row(0));
+}
+
+/// \param image The number of the image.
+///
+/// \return A matrix of type `CV_32F` sharing the memory of the file. Must not be written to.
+cv::Mat fl::DescriptorFile::imageDescriptors(int image) const{
+    return cv::Mat(this->imageRowCount(image), this->rowLength(), CV_32F, (void *)this->row(this->imageFirstRow(image)));
+}
+
+/// \param image The number of the image.
+int fl::DescriptorFile::imageFirstRow(int image) const { return this->index[image].firstRow; }
+
+/// \param image The number of the image.
+int fl::DescriptorFile::imageRowCount(int image) const { return this->index[image].rowCount; }
+
+/// \param image The number of the image.
+std::string fl::DescriptorFile::imageName(int image) const{
+    return std::string(this->data + this->header->namesOffset + this->index[image].nameOffset);
+}
@@ -0,0 +1,169 @@
+/// \file misc/descriptorfile.h
+/// \author Petra Bosilj
+
+#ifndef DESCRIPTORFILE_H
+#define DESCRIPTORFILE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <cstddef>
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+/// \brief The maximal number of dimensions of the bin layout stored in a descriptor file.
+#define DESCRIPTOR_MAX_DIMS 4
+
+namespace fl{
+
+    /// \struct DescriptorFileHeader
+    ///
+    /// \brief The header at the start of a descriptor file.
+    ///
+    /// The file consists of:
+    /// - this header,
+    /// - the descriptors as float32 rows (row-major), starting at `rowsOffset`,
+    /// - the image index, `imageCount` entries of `DescriptorFileEntry` starting at `indexOffset`,
+    /// - the image names, zero-terminated, starting at `namesOffset`.
+    ///
+    /// All the values are stored in the byte order of the machine writing the file.
+    struct DescriptorFileHeader{
+        char magic[8];
+        uint32_t version;
+        uint32_t layoutDims;
+        uint32_t layout[DESCRIPTOR_MAX_DIMS];
+        uint32_t rowLength;
+        uint32_t reserved;
+        uint64_t rowCount;
+        uint64_t imageCount;
+        uint64_t rowsOffset;
+        uint64_t indexOffset;
+        uint64_t namesOffset;
+        uint64_t fileSize;
+    };
+
+    /// \struct DescriptorFileEntry
+    ///
+    /// \brief The entry of an image in the index of a descriptor file.
+    struct DescriptorFileEntry{
+        uint64_t firstRow;
+        uint64_t rowCount;
+        uint64_t nameOffset; ///< Relative to `DescriptorFileHeader::namesOffset`.
+    };
+
+    /// \class DescriptorFileWriter
+    ///
+    /// \brief Writes the descriptors of a set of images into a single binary file,
+    /// to be read with `DescriptorFile`.
+    ///
+    /// The images can be added from several threads and in any order. The rows are
+    /// written in the order of the image numbers, so that the descriptors of image
+    /// `i` directly follow those of image `i-1`.
+    class DescriptorFileWriter{
+        public:
+            /// \brief Constructor, creating the file.
+            DescriptorFileWriter(const std::string &path, const std::vector <int> &layout, int rowLength);
+            ~DescriptorFileWriter();
+
+            /// \brief Check if the file was created successfully.
+            bool isOpen() const;
+
+            /// \brief Add the descriptors of an image.
+            void addImage(int image, const std::string &name, const std::vector <float> &rows);
+
+            /// \brief Write the image index and the header, and close the file.
+            bool close();
+
+        private:
+            DescriptorFileWriter(const DescriptorFileWriter &);
+            DescriptorFileWriter &operator=(const DescriptorFileWriter &);
+
+            std::ofstream out;
+            std::mutex lock;
+            DescriptorFileHeader header;
+
+            int nextImage;
+            std::map <int, std::pair <std::string, std::vector <float> > > pending;
+            std::vector <DescriptorFileEntry> index;
+            std::string names;
+
+            void writeImage(const std::string &name, const std::vector <float> &rows);
+    };
+
+    /// \class DescriptorFile
+    ///
+    /// \brief Read access to a file written by `DescriptorFileWriter`.
+    ///
+    /// The file is memory-mapped, and the descriptors are exposed as a `CV_32F`
+    /// matrix pointing directly to the mapped data (without copying). The matrices
+    /// returned are valid only while the `DescriptorFile` is open.
+    class DescriptorFile{
+        public:
+            DescriptorFile();
+
+            /// \brief Constructor, opening the file \p path.
+            DescriptorFile(const std::string &path);
+            ~DescriptorFile();
+
+            /// \brief Open the file \p path, closing the currently opened file.
+            bool open(const std::string &path);
+
+            /// \brief Close the file.
+            void close();
+
+            /// \brief Check if a file is open.
+            bool isOpen() const;
+
+            /// \brief Check if \p path is a descriptor file.
+            static bool isDescriptorFile(const std::string &path);
+
+            /// \brief The bin layout of the descriptors (e.g. trees x size bins x shape bins).
+            std::vector <int> layout() const;
+
+            /// \brief The length of a descriptor.
+            int rowLength() const;
+
+            /// \brief The total number of descriptors.
+            int rowCount() const;
+
+            /// \brief The number of images.
+            int imageCount() const;
+
+            /// \brief The descriptor \p i.
+            const float *row(int i) const;
+
+            /// \brief All the descriptors, one per row.
+            cv::Mat descriptors() const;
+
+            /// \brief The descriptors of the image \p image, one per row.
+            cv::Mat imageDescriptors(int image) const;
+
+            /// \brief The index of the first descriptor of the image \p image.
+            int imageFirstRow(int image) const;
+
+            /// \brief The number of descriptors of the image \p image.
+            int imageRowCount(int image) const;
+
+            /// \brief The name (path) of the image \p image.
+            std::string imageName(int image) const;
+
+        private:
+            DescriptorFile(const DescriptorFile &);
+            DescriptorFile &operator=(const DescriptorFile &);
+
+            const char *data;
+            size_t size;
+            bool mapped;
+            std::vector <char> buffer;
+
+            const DescriptorFileHeader *header;
+            const DescriptorFileEntry *index;
+
+            bool validate() const;
+    };
+}
+
+#endif // DESCRIPTORFILE_H
@@ -0,0 +1,47 @@
+/// \file misc/parallel.h
+/// \author Petra Bosilj
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <opencv2/core/core.hpp>
+
+namespace fl{
+    namespace detail{
+
+        /// \class ParallelRange
+        ///
+        /// \brief Adapts a functor called as `f(begin, end)` on a half-open range of
+        /// indices to `cv::ParallelLoopBody`.
+        template <class Function>
+        class ParallelRange : public cv::ParallelLoopBody{
+            public:
+                ParallelRange(const Function &f) : f(f) {}
+                void operator()(const cv::Range &range) const { f(range.start, range.end); }
+            private:
+                const Function &f;
+        };
+
+        /// \brief Calls \p f(begin, end) on disjoint blocks covering [0, \p n), in
+        /// parallel through the OpenCV thread pool.
+        ///
+        /// \param n The number of indices (e.g. image rows) to process.
+        /// \param f The functor processing a block of indices. Calls for different
+        /// blocks may run concurrently, and must only write to disjoint data.
+        /// \param grain (optional) The minimal number of indices in a block. Small
+        /// ranges are processed in the calling thread.
+        template <class Function>
+        void parallelFor(int n, const Function &f, int grain = 16){
+            if (n <= 0)
+                return;
+            if (n <= grain || cv::getNumThreads() <= 1){
+                f(0, n);
+                return;
+            }
+            cv::parallel_for_(cv::Range(0, n), ParallelRange<Function>(f), (double)(n + grain - 1) / grain);
+        }
+
+    }
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,272 @@
+/// \file misc/retrieval.cpp
+/// \author Petra Bosilj
+
+#include "retrieval.h"
+#include "parallel.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RETRIEVAL_SSE2
+#endif
+
+/// The number of query descriptors compared together with a block of the database.
+#define QUERY_BLOCK 16
+
+/// The number of database descriptors in a block, chosen so that a block of
+/// pattern spectra stays in the cache while it is compared with all the queries
+/// of a query block.
+#define DATABASE_BLOCK 256
+
+#ifdef RETRIEVAL_SSE2
+static inline float horizontalSum(__m128 v){
+    __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+}
+#endif
+
+/// \param x The first descriptor.
+/// \param y The second descriptor.
+/// \param n The length of the descriptors.
+float fl::distanceL1(const float *x, const float *y, int n){
+    int i = 0;
+    float sum = 0;
+#ifdef RETRIEVAL_SSE2
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8){
+        acc0 = _mm_add_ps(acc0, _mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(y+i))));
+        acc1 = _mm_add_ps(acc1, _mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(x+i+4), _mm_loadu_ps(y+i+4))));
+    }
+    for (; i + 4 <= n; i += 4)
+        acc0 = _mm_add_ps(acc0, _mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(y+i))));
+    sum = horizontalSum(_mm_add_ps(acc0, acc1));
+#endif
+    for (; i < n; ++i)
+        sum += std::abs(x[i] - y[i]);
+    return sum;
+}
+
+/// \param x The first descriptor.
+/// \param y The second descriptor.
+/// \param n The length of the descriptors.
+float fl::distanceL2Square(const float *x, const float *y, int n){
+    int i = 0;
+    float sum = 0;
+#ifdef RETRIEVAL_SSE2
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8){
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(y+i));
+        __m128 d1 = _mm_sub_ps(_mm_loadu_ps(x+i+4), _mm_loadu_ps(y+i+4));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+    }
+    for (; i + 4 <= n; i += 4){
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(y+i));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+    }
+    sum = horizontalSum(_mm_add_ps(acc0, acc1));
+#endif
+    for (; i < n; ++i)
+        sum += (x[i] - y[i]) * (x[i] - y[i]);
+    return sum;
+}
+
+/// The sum of (x_i - y_i)^2 / (x_i + y_i), skipping the bins where both values are 0.
+///
+/// \param x The first descriptor.
+/// \param y The second descriptor.
+/// \param n The length of the descriptors.
+float fl::distanceChiSquare(const float *x, const float *y, int n){
+    int i = 0;
+    float sum = 0;
+#ifdef RETRIEVAL_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4){
+        __m128 a = _mm_loadu_ps(x+i), b = _mm_loadu_ps(y+i);
+        __m128 d = _mm_sub_ps(a, b), s = _mm_add_ps(a, b);
+        // 0/0 gives NaN in the empty bins, masked out
+        acc = _mm_add_ps(acc, _mm_and_ps(_mm_cmpgt_ps(s, zero), _mm_div_ps(_mm_mul_ps(d, d), s)));
+    }
+    sum = horizontalSum(acc);
+#endif
+    for (; i < n; ++i)
+        if (x[i] + y[i] > 0)
+            sum += (x[i] - y[i]) * (x[i] - y[i]) / (x[i] + y[i]);
+    return sum;
+}
+
+/// \param x The first descriptor.
+/// \param y The second descriptor.
+/// \param n The length of the descriptors.
+/// \param type The distance to use.
+float fl::descriptorDistance(const float *x, const float *y, int n, DescriptorDistance type){
+    switch (type){
+        case DescriptorDistance::L1:
+            return distanceL1(x, y, n);
+        case DescriptorDistance::L2:
+            return std::sqrt(distanceL2Square(x, y, n));
+        case DescriptorDistance::chiSquare:
+            return distanceChiSquare(x, y, n);
+    }
+    return 0;
+}
+
+static void checkDescriptors(const cv::Mat &descriptors, int dims, const char *name){
+    if (descriptors.type() != CV_32FC1 || (descriptors.rows && !descriptors.isContinuous()) || (dims >= 0 && descriptors.cols != dims)){
+        std::cerr << "The " << name << " need to be a continuous CV_32F matrix of descriptors of equal length." << std::endl;
+        std::exit(-1);
+    }
+}
+
+/// The queries are processed in blocks of `QUERY_BLOCK`, compared with blocks of
+/// `DATABASE_BLOCK` rows of the database at a time, with the blocks of queries
+/// processed in parallel. Only the \p k nearest rows are kept for every query.
+///
+/// \param queries The query descriptors, one per row (`CV_32F`).
+/// \param database The descriptors to search, one per row (`CV_32F`).
+/// \param k The number of neighbours to find (all the rows of \p database if not smaller).
+/// \param type The distance to use.
+/// \param neighbours Output, the `Neighbour`s of every query ordered by increasing distance
+/// (equal distances ordered by the row).
+void fl::nearestNeighbours(const cv::Mat &queries, const cv::Mat &database, int k, DescriptorDistance type,
+                           std::vector <std::vector <Neighbour> > &neighbours){
+    checkDescriptors(queries, -1, "queries");
+    checkDescriptors(database, queries.cols, "database descriptors");
+
+    int nq = queries.rows, nd = database.rows, dims = queries.cols;
+    k = std::min(k, nd);
+    neighbours.assign(nq, std::vector <Neighbour>());
+
+    fl::detail::parallelFor((nq + QUERY_BLOCK - 1) / QUERY_BLOCK, [&](int begin, int end){
+        for (int b=begin; b < end; ++b){
+            int q0 = b * QUERY_BLOCK, q1 = std::min(nq, q0 + QUERY_BLOCK);
+            std::vector <fl::detail::TopK> best(q1 - q0, fl::detail::TopK(k));
+            for (int d0 = 0; d0 < nd; d0 += DATABASE_BLOCK){
+                int d1 = std::min(nd, d0 + DATABASE_BLOCK);
+                for (int q = q0; q < q1; ++q){
+                    const float *query = queries.ptr<float>(q);
+                    for (int d = d0; d < d1; ++d)
+                        best[q - q0].push(descriptorDistance(query, database.ptr<float>(d), dims, type), d);
+                }
+            }
+            for (int q = q0; q < q1; ++q)
+                best[q - q0].extract(neighbours[q]);
+        }
+    }, 1);
+}
+
+/// The centroids are trained with `cv::kmeans` on a regular sample of \p trainSize
+/// rows, and every row is then assigned to the closest centroid by the L2 distance,
+/// which k-means minimises. The distance \p type is used only to rank the descriptors
+/// in the lists searched.
+///
+/// \param database The descriptors to index, one per row (`CV_32F`). The descriptors are copied.
+/// \param nLists The number of lists (centroids), typically around the square root of the
+/// number of descriptors.
+/// \param type The distance used for the search.
+/// \param trainSize (optional) The number of rows used to train the centroids. By default
+/// 64 per list.
+fl::IVFIndex::IVFIndex(const cv::Mat &database, int nLists, DescriptorDistance type, int trainSize)
+    : type(type), dims(database.cols){
+    checkDescriptors(database, -1, "database descriptors");
+    int n = database.rows;
+    nLists = std::max(1, std::min(nLists, n));
+    if (trainSize < 0)
+        trainSize = 64 * nLists;
+    trainSize = std::max(nLists, std::min(trainSize, n));
+
+    this->listStart.assign(nLists + 1, 0);
+    if (!n)
+        return;
+
+    cv::Mat sample(trainSize, this->dims, CV_32F), labels;
+    for (int i=0; i < trainSize; ++i){
+        const float *src = database.ptr<float>((long long)i * n / trainSize);
+        std::copy(src, src + this->dims, sample.ptr<float>(i));
+    }
+    cv::kmeans(sample, nLists, labels, cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 20, 1e-4),
+               1, cv::KMEANS_PP_CENTERS, this->centroids);
+
+    std::vector <int> assignment(n);
+    fl::detail::parallelFor(n, [&](int begin, int end){
+        for (int i=begin; i < end; ++i){
+            const float *row = database.ptr<float>(i);
+            float bestDist = distanceL2Square(row, this->centroids.ptr<float>(0), this->dims);
+            int best = 0;
+            for (int l=1; l < nLists; ++l){
+                float dist = distanceL2Square(row, this->centroids.ptr<float>(l), this->dims);
+                if (dist < bestDist){
+                    bestDist = dist;
+                    best = l;
+                }
+            }
+            assignment[i] = best;
+        }
+    }, 256);
+
+    for (int i=0; i < n; ++i)
+        ++this->listStart[assignment[i] + 1];
+    for (int l=0; l < nLists; ++l)
+        this->listStart[l+1] += this->listStart[l];
+
+    this->rowIds.resize(n);
+    this->listData.resize((size_t)n * this->dims);
+    std::vector <int> next(this->listStart.begin(), this->listStart.end() - 1);
+    for (int i=0; i < n; ++i){
+        int pos = next[assignment[i]]++;
+        this->rowIds[pos] = i;
+        const float *src = database.ptr<float>(i);
+        std::copy(src, src + this->dims, this->listData.begin() + (size_t)pos * this->dims);
+    }
+}
+
+int fl::IVFIndex::size() const { return this->rowIds.size(); }
+
+int fl::IVFIndex::listCount() const { return this->listStart.size() - 1; }
+
+/// \param query The query descriptor.
+/// \param k The number of neighbours to find.
+/// \param nProbe The number of lists to search, those with the closest centroids (by the
+/// L2 distance, as in the training).
+/// \param neighbours Output, the `Neighbour`s found ordered by increasing distance. Fewer
+/// than \p k if the lists searched hold fewer descriptors.
+void fl::IVFIndex::search(const float *query, int k, int nProbe, std::vector <Neighbour> &neighbours) const{
+    neighbours.clear();
+    int nLists = this->listCount();
+    if (this->rowIds.empty())
+        return;
+    nProbe = std::max(1, std::min(nProbe, nLists));
+
+    std::vector <Neighbour> lists(nLists);
+    for (int l=0; l < nLists; ++l)
+        lists[l] = Neighbour(distanceL2Square(query, this->centroids.ptr<float>(l), this->dims), l);
+    std::partial_sort(lists.begin(), lists.begin() + nProbe, lists.end());
+
+    fl::detail::TopK best(k);
+    for (int p=0; p < nProbe; ++p){
+        int l = lists[p].second;
+        for (int pos = this->listStart[l]; pos < this->listStart[l+1]; ++pos)
+            best.push(descriptorDistance(query, &this->listData[(size_t)pos * this->dims], this->dims, this->type), this->rowIds[pos]);
+    }
+    best.extract(neighbours);
+}
+
+/// \param queries The query descriptors, one per row (`CV_32F`).
+/// \param k The number of neighbours to find.
+/// \param nProbe The number of lists to search.
+/// \param neighbours Output, the `Neighbour`s found for every query.
+void fl::IVFIndex::search(const cv::Mat &queries, int k, int nProbe, std::vector <std::vector <Neighbour> > &neighbours) const{
+    checkDescriptors(queries, this->dims, "queries");
+    neighbours.assign(queries.rows, std::vector <Neighbour>());
+    fl::detail::parallelFor(queries.rows, [&](int begin, int end){
+        for (int q=begin; q < end; ++q)
+            this->search(queries.ptr<float>(q), k, nProbe, neighbours[q]);
+    }, 4);
+}
@@ -0,0 +1,114 @@
+/// \file misc/retrieval.h
+/// \author Petra Bosilj
+
+#ifndef RETRIEVAL_H
+#define RETRIEVAL_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+
+namespace fl{
+
+    /// \brief The distances between descriptors (e.g. pattern spectra) available for retrieval.
+    enum class DescriptorDistance {L1, L2, chiSquare};
+
+    /// \brief The L1 distance between two descriptors.
+    float distanceL1(const float *x, const float *y, int n);
+
+    /// \brief The squared L2 distance between two descriptors.
+    float distanceL2Square(const float *x, const float *y, int n);
+
+    /// \brief The chi-square distance between two non-negative descriptors.
+    float distanceChiSquare(const float *x, const float *y, int n);
+
+    /// \brief The distance of type \p type between two descriptors.
+    float descriptorDistance(const float *x, const float *y, int n, DescriptorDistance type);
+
+    /// \brief A retrieved descriptor: the distance to the query and the row of the descriptor.
+    typedef std::pair <float, int> Neighbour;
+
+    /// \brief Find the \p k nearest rows of \p database for every row of \p queries, by
+    /// exhaustive search.
+    void nearestNeighbours(const cv::Mat &queries, const cv::Mat &database, int k, DescriptorDistance type,
+                           std::vector <std::vector <Neighbour> > &neighbours);
+
+    /// \class IVFIndex
+    ///
+    /// \brief An inverted file index for approximate nearest neighbour search among
+    /// descriptors.
+    ///
+    /// The descriptors are clustered with k-means, and every descriptor is stored in the
+    /// list of its closest centroid. A query is compared only with the descriptors in the
+    /// lists of its `nProbe` closest centroids. Probing all the lists gives the exact result.
+    ///
+    /// The lists are formed and probed by the L2 distance to the centroids, as in the
+    /// k-means training. The distance type of the index ranks the descriptors found.
+    class IVFIndex{
+        public:
+            /// \brief Constructor, indexing the rows of \p database.
+            IVFIndex(const cv::Mat &database, int nLists, DescriptorDistance type = DescriptorDistance::L1, int trainSize = -1);
+
+            /// \brief The number of indexed descriptors.
+            int size() const;
+
+            /// \brief The number of lists (centroids).
+            int listCount() const;
+
+            /// \brief Find the approximate \p k nearest descriptors of \p query.
+            void search(const float *query, int k, int nProbe, std::vector <Neighbour> &neighbours) const;
+
+            /// \brief Find the approximate \p k nearest descriptors for every row of
+            /// \p queries, in parallel.
+            void search(const cv::Mat &queries, int k, int nProbe, std::vector <std::vector <Neighbour> > &neighbours) const;
+
+        private:
+            DescriptorDistance type;
+            int dims;
+            cv::Mat centroids;
+
+            /// \brief The descriptors of list `l` are `rowIds[listStart[l]]` to `rowIds[listStart[l+1]-1]`.
+            std::vector <int> listStart;
+            std::vector <int> rowIds;
+            /// \brief The copies of the descriptors, in the order of `rowIds`.
+            std::vector <float> listData;
+    };
+
+    namespace detail{
+
+        /// \class TopK
+        ///
+        /// \brief Keeps the \p k smallest `Neighbour`s pushed, in a max-heap.
+        class TopK{
+            public:
+                TopK(int k) : k(std::max(k, 0)) { this->heap.reserve(this->k); }
+
+                void push(float dist, int id){
+                    if ((int)this->heap.size() < this->k){
+                        this->heap.push_back(Neighbour(dist, id));
+                        std::push_heap(this->heap.begin(), this->heap.end());
+                    }
+                    else if (this->k > 0 && Neighbour(dist, id) < this->heap.front()){
+                        std::pop_heap(this->heap.begin(), this->heap.end());
+                        this->heap.back() = Neighbour(dist, id);
+                        std::push_heap(this->heap.begin(), this->heap.end());
+                    }
+                }
+
+                /// \brief Move the kept `Neighbour`s to \p out, ordered by increasing distance.
+                void extract(std::vector <Neighbour> &out){
+                    std::sort_heap(this->heap.begin(), this->heap.end());
+                    out.swap(this->heap);
+                    this->heap.clear();
+                }
+
+            private:
+                int k;
+                std::vector <Neighbour> heap;
+        };
+    }
+}
+
+#endif // RETRIEVAL_H
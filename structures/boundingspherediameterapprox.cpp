@@ -2,7 +2,6 @@
 /// \author Petra Bosilj
 
 #include "boundingspherediameterapprox.h"
-#include "areaattribute.h"
 #include "node.h"
 #include "imagetree.h"
 
@@ -11,35 +10,75 @@
 
 const std::string fl::BoundingSphereDiameterApprox::name = "boundingshpere";
 
+/// \return The index of a free slot, re-using a released slot if available.
+int fl::detail::BoundingSphereStore::acquire(){
+    if (!this->freeSlots.empty()){
+        int slot = this->freeSlots.back();
+        this->freeSlots.pop_back();
+        return slot;
+    }
+    int slot = this->centres.size() / this->nDim;
+    this->centres.resize(this->centres.size() + this->nDim);
+    return slot;
+}
+
+/// \param slot The index of the slot returned by `acquire()`.
+void fl::detail::BoundingSphereStore::release(int slot){
+    this->freeSlots.push_back(slot);
+}
+
+/// Copies the channels of the multichannel image into a single band-interleaved-by-pixel
+/// (BIP) array of `double`, so that all the values of one pixel are contiguous. This is done
+/// only once for all the `Node`s of the `ImageTree`. The values are kept as read from the
+/// image, without loss of precision for any depth.
+///
+/// \param imgs The multichannel image, one array element per channel. Only the first `nDim`
+/// channels are used.
+void fl::detail::BoundingSphereStore::buildBIP(const std::vector <cv::Mat> &imgs){
+    if (!this->bip.empty() || imgs.empty())
+        return;
+    int rows = imgs[0].rows;
+    this->cols = imgs[0].cols;
+    this->bip.assign((size_t)rows * this->cols * this->nDim, 0.0);
+    for (int b=0, szb = std::min((int)imgs.size(), this->nDim); b < szb; ++b){
+        double *dst = &(this->bip[b]);
+        for (int y = 0; y < rows; ++y)
+            for (int x = 0; x < this->cols; ++x, dst += this->nDim)
+                *dst = detail::getCvMatElem(imgs[b], x, y);
+    }
+}
+
 /// \details \copydetails Attribute::Attribute()
 fl::BoundingSphereDiameterApprox::BoundingSphereDiameterApprox(const Node *baseNode, const ImageTree *baseTree, AttributeSettings *settings, int deleteSettings)
-: TypedAttribute<double>(baseNode, baseTree, settings, deleteSettings){
+: TypedAttribute<double>(baseNode, baseTree, settings, deleteSettings), slot(-1), area(0){
 
     this->initSettings();
-    if (!(this->myNode->isRoot()))
-        return;
-    this->myTree->addAttributeToTree<fl::AreaAttribute>(new fl::AreaSettings());
-
 }
 
 fl::BoundingSphereDiameterApprox::~BoundingSphereDiameterApprox()
 {
-    BoundingSphereDiameterApproxSettings *mys = (BoundingSphereDiameterApproxSettings *)(this->getSettings());
-    for (int i=0; i < mys->nDim; ++i)
-        delete this->center[i];
-    //dtor
-    if (this->myNode->isRoot())
-        this->myTree->deleteAttributeFromTree<AreaAttribute>();
+    if (this->slot >= 0)
+        this->store->release(this->slot);
 }
 
-/// Initializes the dimensions of the bounding box center with the number of dimensions provided by
+/// Attaches the `BoundingSphereDiameterApprox` to the `detail::BoundingSphereStore` of the
+/// `ImageTree`, held by the root `Node`. A new store is created for the root `Node`,
+/// or when the store of the root does not have the number of dimensions provided by
 /// `BoundingSphereDiameterApproxSettings`.
 void fl::BoundingSphereDiameterApprox::initSettings() {
     TypedAttribute<double>::initSettings();
 
     BoundingSphereDiameterApproxSettings *mys = (BoundingSphereDiameterApproxSettings *)(this->getSettings());
     this->attValue = 0;
-    this->center.reserve(mys->nDim);
+
+    const Node *root = this->myTree->root();
+    BoundingSphereDiameterApprox *rootAttribute = (root == this->myNode) ? NULL :
+        (BoundingSphereDiameterApprox *)(root->getAttribute(BoundingSphereDiameterApprox::name));
+
+    if (rootAttribute != NULL && rootAttribute->store && rootAttribute->store->nDim == mys->nDim)
+        this->store = rootAttribute->store;
+    else
+        this->store = std::make_shared<detail::BoundingSphereStore>(mys->nDim);
 }
 
 /// Changes the settings of this `BoundingSphereDiameterApprox` as set with new `AttributeSettings` (which have to be
@@ -57,15 +96,13 @@ bool fl::BoundingSphereDiameterApprox::changeSettings(AttributeSettings *nsettin
     BoundingSphereDiameterApproxSettings *nys = (BoundingSphereDiameterApproxSettings *)nsettings;
 
     if (mys->nDim != nys->nDim){
-        for (int i=0; i < mys->nDim; ++i)
-            delete this->center[i];
-        this->center.resize(0);
+        if (this->slot >= 0)
+            this->store->release(this->slot);
+        this->slot = -1;
         mys->nDim = nys->nDim;
+        this->vset() = false;
         this->initSettings();
     }
-    else{
-        for (int i=0; i < mys->nDim; ++i, *(this->center[i]) = 0);
-    }
     mys->distance = nys->distance;
 
     TypedAttribute<double>::changeSettings(nsettings, deleteSettings);
@@ -74,9 +111,25 @@ bool fl::BoundingSphereDiameterApprox::changeSettings(AttributeSettings *nsettin
 
 }
 
-/// Calculation of the `RangeAttribute`. The calculation is done efficiently, by
-/// re-using the values of the child `Node`s.
-/// Any image element (pixel) position in the `ImageTree` is examined at most once.
+/// \param slot The slot of the centre in the `detail::BoundingSphereStore`.
+///
+/// \return Pointers to the `nDim` values of the centre, as expected by the distance function
+/// from `BoundingSphereDiameterApproxSettings`.
+std::vector <double *> fl::BoundingSphereDiameterApprox::centreView(int slot) const{
+    std::vector <double *> view(this->store->nDim);
+    double *c = this->store->centre(slot);
+    for (int j=0, szj = view.size(); j < szj; ++j)
+        view[j] = c + j;
+    return view;
+}
+
+/// Calculation of the `BoundingSphereDiameterApprox`. The calculation is done efficiently, by
+/// re-using the centres, areas and values of the child `Node`s.
+/// Any image element (pixel) position in the `ImageTree` is examined at most once, and all
+/// the channels of a pixel are read from a contiguous (BIP) copy of the multichannel image.
+///
+/// The centres of the child `Node`s are released once the value of this `Node` is calculated,
+/// and the BIP copy of the image once the value of the root is calculated.
 ///
 /// \note A multivariate image needs to be associated to the `ImageTree` before
 /// this function is called. This can be done by `ImageTree::setImages` (one image
@@ -90,51 +143,65 @@ void fl::BoundingSphereDiameterApprox::calculateAttribute(){
     }
 
     BoundingSphereDiameterApproxSettings *mys = (BoundingSphereDiameterApproxSettings *)(this->getSettings());
-    const std::vector<cv::Mat> &imgs = this->myTree->images();
+    detail::BoundingSphereStore &st = *(this->store);
+    const int nDim = st.nDim;
+
+    st.buildBIP(this->myTree->images());
+
+    std::vector <Attribute *> childBB;
+    this->myNode->getChildrenAttributes(BoundingSphereDiameterApprox::name, childBB);
+
+    // children first, their calculation can move the storage
+    for (int i=0, szi = childBB.size(); i < szi; ++i){
+        BoundingSphereDiameterApprox *cBB = ((BoundingSphereDiameterApprox *)childBB[i]);
+        if (cBB->slot < 0) // centre already released, recalculate
+            cBB->vset() = false;
+        cBB->value();
+    }
 
-    int totalArea = 0;
+    if (this->slot < 0)
+        this->slot = st.acquire();
+    double *c = st.centre(this->slot);
+    std::fill(c, c + nDim, 0.0);
 
     const std::vector <std::pair<int, int> > &ownElems = this->myNode->getOwnElements();
     for (int i=0, szi = ownElems.size(); i < szi; ++i){
-        for (int j=0, szj = imgs.size(); j < szj; ++j){
-            if (i == 0)
-                this->center.emplace_back(new double(detail::getCvMatElem(imgs[j], ownElems[i].X, ownElems[i].Y)));
-            else
-                *(this->center[j]) += detail::getCvMatElem(imgs[j], ownElems[i].X, ownElems[i].Y);
-        }
+        const double *px = st.pixel(ownElems[i].X, ownElems[i].Y);
+        for (int j=0; j < nDim; ++j)
+            c[j] += px[j];
     }
 
-    totalArea += ownElems.size();
-
-    std::vector <Attribute *> childBB;
-    this->myNode->getChildrenAttributes(BoundingSphereDiameterApprox::name, childBB);
-    std::vector <Attribute *> childSizes;
-    this->myNode->getChildrenAttributes(AreaAttribute::name, childSizes);
+    int totalArea = ownElems.size();
 
     for (int i=0, szi = childBB.size(); i < szi; ++i){
-
         BoundingSphereDiameterApprox *cBB = ((BoundingSphereDiameterApprox *)childBB[i]);
-        cBB->value();
-        AreaAttribute *cArea = ((AreaAttribute *)childSizes[i]);
-        for (int j=0, szj = imgs.size(); j < szj; ++j){
-            if ((int)this->center.size() < szj)
-                this->center.emplace_back(new double(*(cBB->center[j])*cArea->value()));
-            else
-                *(this->center[j]) += *(cBB->center[j])*cArea->value();
-        }
-        totalArea += cArea->value();
+        const double *cc = st.centre(cBB->slot);
+        const double cArea = cBB->area;
+        for (int j=0; j < nDim; ++j)
+            c[j] += cc[j] * cArea;
+        totalArea += cBB->area;
     }
-    for (int j=0, szj = this->center.size(); j < szj; ++j)
-        *(this->center[j]) /= totalArea;
+    for (int j=0; j < nDim; ++j)
+        c[j] /= totalArea;
+    this->area = totalArea;
 
     double nr = 0;
+    std::vector <double *> myCentre = this->centreView(this->slot);
     for (int i=0, szi = childBB.size(); i < szi; ++i){
         BoundingSphereDiameterApprox *cBB = ((BoundingSphereDiameterApprox *)childBB[i]);
-        double distNow = cBB->value()/2 + mys->distance(cBB->center, this->center);
+        double distNow = cBB->attValue/2 + mys->distance(cBB->centreView(cBB->slot), myCentre);
         if (distNow > nr)
             nr = distNow;
     }
 
+    for (int i=0, szi = childBB.size(); i < szi; ++i){
+        BoundingSphereDiameterApprox *cBB = ((BoundingSphereDiameterApprox *)childBB[i]);
+        st.release(cBB->slot);
+        cBB->slot = -1;
+    }
+    if (this->myNode->isRoot())
+        st.releaseBIP();
+
     this->attValue = nr * 2;
 
     TypedAttribute<double>::calculateAttribute();
@@ -4,9 +4,56 @@
 #include "attribute.h"
 
 #include <functional>
+#include <memory>
+
+#include <opencv2/core/core.hpp>
 
 namespace fl{
 
+    namespace detail{
+
+    /// \class BoundingSphereStore
+    ///
+    /// \brief Storage shared by all the `BoundingSphereDiameterApprox` of one `ImageTree`.
+    ///
+    /// Holds the centres of the bounding spheres in a single contiguous array, one slot of
+    /// `nDim` consecutive values per `Node`, and the band-interleaved-by-pixel (BIP) copy
+    /// of the multichannel image. Slots of the `Node`s whose parent has been calculated are
+    /// released and re-used, so only the centres along the calculation front are kept.
+        class BoundingSphereStore{
+            public:
+                /// \brief Constructor of the `BoundingSphereStore` for \p nDim dimensions.
+                BoundingSphereStore(int nDim) : nDim(nDim), cols(0) {}
+
+                /// \brief Reserves a slot for a centre and returns its index.
+                int acquire();
+
+                /// \brief Returns the slot \p slot to the store for re-use.
+                void release(int slot);
+
+                /// \brief Pointer to the first value of the centre in slot \p slot.
+                ///
+                /// \note Invalidated by the next call to `acquire()`.
+                double *centre(int slot) { return &(this->centres[(size_t)slot * this->nDim]); }
+
+                /// \brief Builds the BIP copy of the multichannel image, if not already built.
+                void buildBIP(const std::vector <cv::Mat> &imgs);
+
+                /// \brief Pointer to the `nDim` consecutive values of the pixel at (\p x, \p y).
+                const double *pixel(int x, int y) const { return &(this->bip[((size_t)y * this->cols + x) * this->nDim]); }
+
+                /// \brief Frees the memory held by the BIP copy of the multichannel image.
+                void releaseBIP() { std::vector <double>().swap(this->bip); }
+
+                const int nDim; ///< Number of dimensions (bands) of the centres.
+            private:
+                std::vector <double> centres;
+                std::vector <int> freeSlots;
+                std::vector <double> bip;
+                int cols;
+        };
+    }
+
 /// \class BoundingSphereDiameterApproxSettings
 ///
 /// \brief Holder for all the `AttributeSettings` of the `BoundingShpereDiameterApproxAttribute`
@@ -50,6 +97,10 @@ namespace fl{
 ///
 /// This is an increasing attribute, meaning that the value of a `Node` will always be higher or
 /// equal than that of it's children `Node`s.
+///
+/// The centres of the bounding spheres are kept in a `detail::BoundingSphereStore` shared by
+/// all the `Node`s of the `ImageTree`, and the centres of the children are released as soon
+/// as the value of their parent is calculated.
     class BoundingSphereDiameterApprox : public TypedAttribute<double>
     {
         public:
@@ -72,11 +123,17 @@ namespace fl{
             virtual bool changeSettings(AttributeSettings *nsettings, bool deleteSettings = false);
         private:
 
-            /// \brief Estimated radius of the bounding box
-            double radius;
+            /// \brief Builds the view of the centre in slot \p slot expected by the distance function.
+            std::vector <double *> centreView(int slot) const;
+
+            /// \brief The storage shared among the `Node`s of the `ImageTree`.
+            std::shared_ptr <detail::BoundingSphereStore> store;
+
+            /// \brief Slot of the estimated center of the bounding box in the `store`, -1 if not held.
+            int slot;
 
-            /// \brief Estimated center of the bounding box.
-            std::vector <double *> center;
+            /// \brief Number of pixels of the region.
+            int area;
     };
 
 }
@@ -0,0 +1,37 @@
+/// \file structures/compiledbinning.cpp
+/// \author Petra Bosilj
+
+#include "compiledbinning.h"
+
+/// \param binning The `Binning` to precompute. Needs a fixed range (not `NODE_VAL`).
+fl::CompiledBinning::CompiledBinning(const Binning &binning)
+    : binning(binning), minValue(binning.minValue), maxValue(binning.maxValue), range(binning.range),
+      lutReady(false), arbitrary(binning.scale == Binning::Scale::arbitrary), limits(binning.binUpperLimits), searchStep(0){
+    this->binning.compiled.reset(); // the copy bins the values directly
+
+    // the largest power of 2 not larger than the number of limits
+    if (!this->limits.empty())
+        for (this->searchStep = 1; this->searchStep * 2 <= (int)this->limits.size(); this->searchStep *= 2);
+}
+
+/// The lookup table is filled with `Binning::getBin()` itself, so that the bins
+/// are identical to those of the `Binning`.
+void fl::CompiledBinning::buildLut() const{
+    if (this->range <= 0 || this->range > BINNING_LUT_LIMIT)
+        return;
+    this->lut.resize(this->range);
+    for (int k=0; k < this->range; ++k)
+        this->lut[k] = this->binning.getBinDirect(this->minValue + k);
+    this->lutReady.store(true, std::memory_order_release);
+}
+
+/// Builds the lookup table on the first call.
+///
+/// \param values The values to bin.
+/// \param bins Output, the bin of each value.
+/// \param n The number of values.
+void fl::CompiledBinning::getBins(const double *values, int *bins, int n) const{
+    std::call_once(this->lutOnce, &CompiledBinning::buildLut, this);
+    for (int i=0; i < n; ++i)
+        bins[i] = this->getBin(values[i]);
+}
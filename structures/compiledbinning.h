@@ -0,0 +1,80 @@
+/// \file structures/compiledbinning.h
+/// \author Petra Bosilj
+
+#ifndef COMPILEDBINNING_H
+#define COMPILEDBINNING_H
+
+#include "patternspectra2d.h"
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+/// \brief The largest range of a `Binning` for which a lookup table of all the
+/// integral values is built by `CompiledBinning`.
+#define BINNING_LUT_LIMIT (1 << 18)
+
+namespace fl{
+
+    /// \class CompiledBinning
+    ///
+    /// \brief A precomputed form of a `Binning`, giving the same bins as
+    /// `Binning::getBin()` with less work per value.
+    ///
+    /// - For a range of at most `BINNING_LUT_LIMIT` values, the bins of all the
+    ///   integral values in the range (e.g. areas) are stored in a lookup table.
+    ///   The table is built on the first call to `getBins()`, so that a `Binning`
+    ///   used only for a few values does not pay for it.
+    /// - For `Binning::arbitrary`, the limits are searched with a fixed number of
+    ///   steps, without branches depending on the comparisons.
+    /// - Other values are binned as by the `Binning`.
+    ///
+    /// \note Created by the `Binning` constructors, and shared between all the
+    /// copies of a `Binning`.
+    class CompiledBinning{
+        public:
+            /// \brief Constructor, precomputing \p binning.
+            CompiledBinning(const Binning &binning);
+
+            /// \brief Determine the bin index for a value.
+            int getBin(double value) const{
+                if (value >= this->minValue && value < this->maxValue && this->lutReady.load(std::memory_order_acquire)){
+                    int k = (int)value;
+                    if (k == value)
+                        return this->lut[k - this->minValue];
+                }
+                if (this->arbitrary && value >= this->minValue && value < this->maxValue)
+                    return this->searchLimits((value - this->minValue) / this->range) + 1;
+                return this->binning.getBinDirect(value);
+            }
+
+            /// \brief Determine the bin indexes for an array of values.
+            void getBins(const double *values, int *bins, int n) const;
+
+        private:
+            Binning binning;
+            int minValue, maxValue, range;
+            mutable std::vector <int> lut;
+            mutable std::once_flag lutOnce;
+            mutable std::atomic <bool> lutReady;
+
+            /// \brief Fill the lookup table (once, thread-safe).
+            void buildLut() const;
+
+            bool arbitrary;
+            std::vector <double> limits;
+            int searchStep;
+
+            /// \brief The number of limits smaller or equal to \p valueScaled.
+            int searchLimits(double valueScaled) const{
+                int lo = 0, szl = this->limits.size();
+                for (int step = this->searchStep; step > 0; step >>= 1){
+                    int next = lo + step;
+                    lo = (next <= szl && this->limits[next-1] <= valueScaled) ? next : lo;
+                }
+                return lo;
+            }
+    };
+}
+
+#endif // COMPILEDBINNING_H
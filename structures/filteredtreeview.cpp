@@ -0,0 +1,128 @@
+/// \file structures/filteredtreeview.cpp
+/// \author Petra Bosilj
+
+#include "filteredtreeview.h"
+
+#include "imagetree.h"
+#include "inclusionnode.h"
+#include "partitioningnode.h"
+
+namespace fl{
+    namespace detail{
+
+        /// Creates the `Node`s of type \p NodeType for the surviving `Node`s of a view,
+        /// bottom-up.
+        ///
+        /// \param order The `Node`s of the base tree, in top-down order.
+        /// \param parentIdx The index of the parent of each `Node` in \p order.
+        /// \param rep The surviving `Node` holding the pixels of each `Node` in \p order.
+        /// \param S The pixels of each surviving `Node`.
+        /// \param created Output, the created `Node` for each surviving `Node` (NULL for others).
+        ///
+        /// \return The root of the created hierarchy.
+        template <class NodeType>
+        Node *materialiseNodes(const std::vector <Node *> &order, const std::vector <int> &parentIdx,
+                               const std::vector <int> &rep, std::vector <std::vector <std::pair <int, int> > > &S,
+                               std::vector <Node *> &created){
+            int szn = order.size();
+            std::vector <std::vector <NodeType *> > children(szn);
+            created.assign(szn, NULL);
+
+            for (int i = szn-1; i >= 0; --i){
+                if (rep[i] != i)
+                    continue;
+                NodeType *n = new NodeType(S[i], children[i]);
+                std::vector <std::pair <int, int> >().swap(S[i]);
+                std::vector <NodeType *>().swap(children[i]);
+                created[i] = n;
+                if (i > 0)
+                    children[rep[parentIdx[i]]].push_back(n);
+            }
+            return created[0];
+        }
+    }
+}
+
+/// \param tree The base `ImageTree`. Needs to outlive this view and all the views
+/// sharing its index.
+fl::FilteredTreeView::FilteredTreeView(const ImageTree &tree)
+    : index(std::make_shared <TreeReconstruction>(tree)) {}
+
+/// \param base The index of the base tree, obtained from another view with `base()`.
+fl::FilteredTreeView::FilteredTreeView(const std::shared_ptr <const TreeReconstruction> &base)
+    : index(base) {}
+
+const std::shared_ptr <const fl::TreeReconstruction> &fl::FilteredTreeView::base() const { return this->index; }
+
+/// \param node The index of the `Node` in `base()->nodes()`.
+bool fl::FilteredTreeView::isRemoved(int node) const{
+    return this->removedTo.count(node) > 0;
+}
+
+/// \param node The index of the `Node` in `base()->nodes()`.
+/// \return The index of the closest surviving ancestor of the `Node` (the
+/// `Node` itself if it survives).
+int fl::FilteredTreeView::representative(int node) const{
+    std::unordered_map <int, int>::const_iterator it = this->removedTo.find(node);
+    return (it == this->removedTo.end()) ? node : it->second;
+}
+
+/// \param node The index of the `Node` in `base()->nodes()`.
+/// \return The gray level of the surviving `Node` holding the pixels of the `Node`.
+int fl::FilteredTreeView::grayLevel(int node) const{
+    node = this->representative(node);
+    std::unordered_map <int, int>::const_iterator it = this->grayLevels.find(node);
+    return (it == this->grayLevels.end()) ? this->index->nodes()[node]->grayLevel() : it->second;
+}
+
+int fl::FilteredTreeView::changedNodes() const{
+    return this->removedTo.size() + this->grayLevels.size();
+}
+
+/// \param out Output, the image of the filtered tree (cf. `TreeReconstruction::render()`).
+/// \param depth The depth of \p out.
+void fl::FilteredTreeView::reconstruct(cv::Mat &out, int depth) const{
+    std::vector <double> values(this->index->nodes().size());
+    for (int i=0, szi = values.size(); i < szi; ++i)
+        values[i] = this->grayLevel(i);
+    this->index->render(out, values, 1, depth);
+}
+
+/// Creates new `Node`s (of the same type as the base tree) for all the surviving
+/// `Node`s, holding their own pixels and those of the removed `Node`s they represent,
+/// with the levels and gray levels of this view. The base tree is not modified.
+///
+/// \note The `Attribute`s are not copied to the new tree.
+///
+/// \return A new `ImageTree`, to be deleted by the caller.
+fl::ImageTree *fl::FilteredTreeView::materialise() const{
+    const std::vector <Node *> &order = this->index->nodes();
+    const std::vector <int> &parentIdx = this->index->parents();
+    int szn = order.size();
+
+    std::vector <int> rep(szn);
+    std::vector <std::vector <std::pair <int, int> > > S(szn);
+    for (int i=0; i < szn; ++i){
+        rep[i] = this->representative(i);
+        const std::vector <std::pair <int, int> > &own = order[i]->getOwnElements();
+        S[rep[i]].insert(S[rep[i]].end(), own.begin(), own.end());
+    }
+
+    std::vector <Node *> created;
+    Node *root;
+    if (dynamic_cast <const PartitioningNode *>(order[0]) != NULL)
+        root = detail::materialiseNodes<PartitioningNode>(order, parentIdx, rep, S, created);
+    else
+        root = detail::materialiseNodes<InclusionNode>(order, parentIdx, rep, S, created);
+
+    for (int i=0; i < szn; ++i){
+        if (created[i] == NULL)
+            continue;
+        created[i]->assignLevel(order[i]->level());
+        created[i]->_grayLevel = this->grayLevel(i);
+        created[i]->_hgrayLevels = order[i]->hyperGraylevel();
+    }
+
+    const ImageTree &tree = this->index->baseTree();
+    return new ImageTree(root, std::make_pair(tree.treeHeight(), tree.treeWidth()));
+}
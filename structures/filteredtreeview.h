@@ -0,0 +1,90 @@
+/// \file structures/filteredtreeview.h
+/// \author Petra Bosilj
+
+#ifndef FILTEREDTREEVIEW_H
+#define FILTEREDTREEVIEW_H
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include <opencv2/core/core.hpp>
+
+#include "treereconstruction.h"
+
+namespace fl{
+
+    class ImageTree;
+
+    /// \class FilteredTreeView
+    ///
+    /// \brief A copy-on-write snapshot of a filtered `ImageTree`.
+    ///
+    /// The view records the effect of filtering (removed `Node`s, and the adjusted gray
+    /// levels of the surviving ones) in side tables over an unmodified base `ImageTree`.
+    /// The index of the base tree (cf. `TreeReconstruction`) is shared between all the
+    /// views created from it, so that several filtering variants of the same tree only
+    /// cost memory proportional to the number of `Node`s they change.
+    ///
+    /// Filtering can be applied repeatedly on the same view, with the same semantics as
+    /// consecutive calls to `ImageTree::filterTreeByLevelPredicate()` and
+    /// `ImageTree::filterTreeByAttributePredicate()`. A real `ImageTree` can be obtained
+    /// with `materialise()`.
+    ///
+    /// \note The base `ImageTree` must not be modified while views over it exist. Soft
+    /// filtering rules are evaluated as their hard counterparts, and the hyper gray levels
+    /// are not adjusted.
+    class FilteredTreeView{
+        public:
+            /// \brief Constructor, creating an unfiltered view over \p tree.
+            FilteredTreeView(const ImageTree &tree);
+
+            /// \brief Constructor, creating an unfiltered view sharing the index \p base.
+            FilteredTreeView(const std::shared_ptr <const TreeReconstruction> &base);
+
+            /// \brief The index of the base tree, to be shared with other views.
+            const std::shared_ptr <const TreeReconstruction> &base() const;
+
+            /// \brief Filter the view with a predicate on the values of `Node::level()`.
+            template<class Function>
+            void filterByLevelPredicate(Function predicate, int rule = 0);
+
+            /// \brief Filter the view with a predicate on the values of an `Attribute`.
+            template<class TAT, class Function>
+            void filterByAttributePredicate(Function predicate, int rule = 0);
+
+            /// \brief Check if a `Node` of the base tree is removed in this view.
+            bool isRemoved(int node) const;
+
+            /// \brief The surviving `Node` holding the pixels of a `Node` of the base tree.
+            int representative(int node) const;
+
+            /// \brief The gray level of a `Node` of the base tree in this view.
+            int grayLevel(int node) const;
+
+            /// \brief The number of `Node`s removed or adjusted in this view.
+            int changedNodes() const;
+
+            /// \brief Reconstruct the filtered image.
+            void reconstruct(cv::Mat &out, int depth = CV_8U) const;
+
+            /// \brief Build a new `ImageTree` corresponding to this view.
+            ImageTree *materialise() const;
+
+        private:
+            std::shared_ptr <const TreeReconstruction> index;
+
+            /// \brief Removed `Node`s, mapped to the surviving `Node` holding their pixels.
+            std::unordered_map <int, int> removedTo;
+
+            /// \brief Surviving `Node`s whose gray level differs from the base tree.
+            std::unordered_map <int, int> grayLevels;
+
+            template<class T, class Function>
+            void applyFilter(const std::vector <T> &values, Function predicate, int rule);
+    };
+}
+
+#include "filteredtreeview.tpp"
+
+#endif // FILTEREDTREEVIEW_H
@@ -0,0 +1,122 @@
+/// \file structures/filteredtreeview.tpp
+/// \author Petra Bosilj
+
+#ifndef TPP_FILTEREDTREEVIEW
+#define TPP_FILTEREDTREEVIEW
+
+#include "filteredtreeview.h"
+
+#include "node.h"
+
+#include <iostream>
+#include <cstdlib>
+
+namespace fl{
+
+/// \param predicate The functor object which operates on the levels.
+/// \note cf. the class `Predicate` to see the correct form of this
+/// functor.
+///
+/// \param rule Filtering rule to be used (cf. `ImageTree::filterTreeByLevelPredicate()`).
+template<class Function>
+void FilteredTreeView::filterByLevelPredicate(Function predicate, int rule){
+    const std::vector <Node *> &order = this->index->nodes();
+
+    std::vector <double> values(order.size());
+    for (int i=0, szi = order.size(); i < szi; ++i)
+        values[i] = order[i]->level();
+
+    this->applyFilter(values, predicate, rule);
+}
+
+/// \tparam TAT Specifies the `TypedAttribute` whose values are used in the evaluation
+/// of the \p predicate. Must be assigned to the base tree with `addAttributeToTree`.
+///
+/// \param predicate The functor object which operates on the `Attribute` values.
+/// \param rule Filtering rule to be used (cf. `ImageTree::filterTreeByAttributePredicate()`).
+template<class TAT, class Function>
+void FilteredTreeView::filterByAttributePredicate(Function predicate, int rule){
+    const std::vector <Node *> &order = this->index->nodes();
+
+    std::vector <typename TAT::attribute_type> values;
+    values.reserve(order.size());
+    for (int i=0, szi = order.size(); i < szi; ++i)
+        values.push_back(((TAT*)order[i]->getAttribute(TAT::name))->value());
+
+    this->applyFilter(values, predicate, rule);
+}
+
+/// Filters the `Node`s which survive in this view, in a top-down pass over the base
+/// tree. The `Node`s removed earlier are skipped: their children are evaluated against
+/// the closest surviving ancestor, as they would be in the filtered `ImageTree`.
+/// Only the removed and the adjusted `Node`s are stored after the pass.
+template<class T, class Function>
+void FilteredTreeView::applyFilter(const std::vector <T> &values, Function predicate, int rule){
+    if (rule < 0 || rule > 5){
+        std::cerr << "Unknown filtering rule " << rule << "." << std::endl;
+        std::exit(-2);
+    }
+    int baseRule = rule % 3;
+
+    const std::vector <Node *> &order = this->index->nodes();
+    const std::vector <int> &parentIdx = this->index->parents();
+    int szn = order.size();
+
+    // state: 0 = surviving, 1 = removed by this filtering, 2 = removed before
+    std::vector <char> state(szn, 0);
+    // closest surviving ancestor (the Node itself if it survives)
+    std::vector <int> kept(szn, 0);
+    // gray levels before this filtering, and contrast accumulated from removed ancestors
+    std::vector <int> gray(szn);
+    std::vector <int> contrast(szn, 0);
+    // some ancestor was removed by this filtering (max rules)
+    std::vector <char> cut(szn, 0);
+    // closest Node in the view before this filtering (the Node itself if not removed before)
+    std::vector <int> visible(szn, 0);
+
+    for (int i=0; i < szn; ++i)
+        gray[i] = this->grayLevel(i);
+
+    for (int i=1; i < szn; ++i){
+        int p = parentIdx[i];
+        int anc = kept[p];
+
+        cut[i] = cut[p] || state[p] == 1;
+        contrast[i] = contrast[p];
+        // a parent removed by this filtering adds the contrast of its own edge in the view
+        if (baseRule == 1 && state[p] == 1)
+            contrast[i] += gray[visible[parentIdx[p]]] - gray[p];
+
+        if (this->removedTo.count(i)){
+            state[i] = 2;
+            kept[i] = anc;
+            visible[i] = visible[p];
+        }
+        else if ((baseRule == 2 && cut[i]) || predicate(values[i], values[anc]) == false){
+            state[i] = 1;
+            kept[i] = anc;
+            visible[i] = i;
+        }
+        else
+            kept[i] = visible[i] = i;
+    }
+
+    this->removedTo.clear();
+    for (int i=0; i < szn; ++i){
+        if (state[i] != 0){
+            this->removedTo[i] = kept[i];
+            this->grayLevels.erase(i);
+        }
+        else if (contrast[i] != 0){
+            int ng = gray[i] + contrast[i];
+            if (ng == order[i]->grayLevel())
+                this->grayLevels.erase(i);
+            else
+                this->grayLevels[i] = ng;
+        }
+    }
+}
+
+}
+
+#endif // TPP_FILTEREDTREEVIEW
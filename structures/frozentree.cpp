@@ -0,0 +1,125 @@
+/// \file structures/frozentree.cpp
+/// \author Petra Bosilj
+
+#include "frozentree.h"
+
+#include "imagetree.h"
+#include "node.h"
+
+/// Traverses the tree iteratively (depth-first), assigning the preorder positions,
+/// recording the Euler tour for the LCA queries, and laying out the pixels of each
+/// `Node` in preorder. Subtree sizes are then accumulated bottom-up.
+///
+/// \param tree The `ImageTree` to freeze.
+fl::FrozenTree::FrozenTree(const ImageTree &tree) : rmq(NULL){
+    // (Node, parent position, next child to visit)
+    std::vector <std::pair <const Node *, std::pair <int, int> > > stack;
+    stack.push_back(std::make_pair(tree.root(), std::make_pair(-1, 0)));
+    std::vector <int> stackPos;
+
+    while (!stack.empty()){
+        const Node *cur = stack.back().first;
+        int &next = stack.back().second.second;
+
+        if (next == 0){ // entering the Node
+            int i = this->order.size();
+            int p = stack.back().second.first;
+            this->order.push_back(cur);
+            this->positions[cur] = i;
+            this->parentIdx.push_back(p);
+            this->depths.push_back(p < 0 ? 0 : this->depths[p] + 1);
+            this->levels.push_back(cur->level());
+            this->grayLevels.push_back(cur->grayLevel());
+            this->firstVisit.push_back(this->tourNode.size());
+
+            const std::vector <std::pair <int, int> > &own = cur->getOwnElements();
+            this->pixelStart.push_back(this->allPixels.size());
+            this->allPixels.insert(this->allPixels.end(), own.begin(), own.end());
+            stackPos.push_back(i);
+        }
+        int i = stackPos.back();
+        this->tourNode.push_back(i);
+        this->tourDepth.push_back(this->depths[i]);
+
+        if (next < (int)cur->_children.size()){
+            const Node *child = cur->_children[next++];
+            stack.push_back(std::make_pair(child, std::make_pair(i, 0)));
+        }
+        else{
+            stack.pop_back();
+            stackPos.pop_back();
+        }
+    }
+
+    int szn = this->order.size();
+    this->subtreeNodes.assign(szn, 1);
+    this->subtreePixels.resize(szn);
+    for (int i=0; i < szn; ++i)
+        this->subtreePixels[i] = this->order[i]->getOwnElements().size();
+    for (int i = szn-1; i > 0; --i){
+        this->subtreeNodes[this->parentIdx[i]] += this->subtreeNodes[i];
+        this->subtreePixels[this->parentIdx[i]] += this->subtreePixels[i];
+    }
+
+    if (this->tourDepth.size() > 1)
+        this->rmq = new detail::CompactRMQPlusMinusOne(this->tourDepth);
+}
+
+fl::FrozenTree::~FrozenTree(){
+    delete this->rmq;
+}
+
+int fl::FrozenTree::size() const { return this->order.size(); }
+
+const fl::Node *fl::FrozenTree::node(int i) const { return this->order[i]; }
+
+int fl::FrozenTree::index(const Node *n) const{
+    std::unordered_map <const Node *, int>::const_iterator it = this->positions.find(n);
+    return (it == this->positions.end()) ? -1 : it->second;
+}
+
+int fl::FrozenTree::parent(int i) const { return this->parentIdx[i]; }
+
+/// \return The position of the ancestor, or of the root if \p depth is larger than
+/// the depth of the `Node`.
+int fl::FrozenTree::ancestor(int i, int depth) const{
+    for (; depth > 0 && this->parentIdx[i] >= 0; --depth)
+        i = this->parentIdx[i];
+    return i;
+}
+
+int fl::FrozenTree::depth(int i) const { return this->depths[i]; }
+
+double fl::FrozenTree::level(int i) const { return this->levels[i]; }
+
+int fl::FrozenTree::grayLevel(int i) const { return this->grayLevels[i]; }
+
+int fl::FrozenTree::elementCount(int i) const { return this->subtreePixels[i]; }
+
+int fl::FrozenTree::nodeCount(int i) const { return this->subtreeNodes[i]; }
+
+/// Checks the inclusion of the preorder ranges, in O(1).
+bool fl::FrozenTree::isAncestor(int a, int b) const{
+    return a <= b && b < a + this->subtreeNodes[a];
+}
+
+/// Answered in O(1) by a range minimum query on the depths along the Euler tour.
+int fl::FrozenTree::LCA(int a, int b) const{
+    if (this->isAncestor(a, b))
+        return a;
+    if (this->isAncestor(b, a))
+        return b;
+    return this->tourNode[(*this->rmq)(this->firstVisit[a], this->firstVisit[b])];
+}
+
+/// \return The half-open range [first, second) of `pixels()`.
+std::pair <int, int> fl::FrozenTree::pixelRange(int i) const{
+    return std::make_pair(this->pixelStart[i], this->pixelStart[i] + this->subtreePixels[i]);
+}
+
+/// \return The half-open range [first, second) of `pixels()`.
+std::pair <int, int> fl::FrozenTree::ownPixelRange(int i) const{
+    return std::make_pair(this->pixelStart[i], this->pixelStart[i] + (int)this->order[i]->getOwnElements().size());
+}
+
+const std::vector <std::pair <int, int> > &fl::FrozenTree::pixels() const { return this->allPixels; }
@@ -0,0 +1,129 @@
+/// \file structures/frozentree.h
+/// \author Petra Bosilj
+
+#ifndef FROZENTREE_H
+#define FROZENTREE_H
+
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "../misc/commontreedetail.h"
+
+namespace fl{
+
+    class ImageTree;
+    class Node;
+
+    /// \class FrozenTree
+    ///
+    /// \brief An immutable, read-only snapshot of an `ImageTree`, for queries from any
+    /// number of threads concurrently.
+    ///
+    /// All the values which `Node` and `ImageTree` compute lazily (element and `Node`
+    /// counts, `Attribute` values, the LCA structures) are computed once on construction
+    /// and stored in flat arrays indexed by the preorder position of the `Node`s. The
+    /// values of the `Attribute`s selected when freezing are copied as well. No query
+    /// modifies any state, so no locking is needed.
+    ///
+    /// In preorder, the subtree of a `Node` occupies a contiguous range of indices, and
+    /// the pixels of the tree are stored in the same order, so that the pixels of every
+    /// subtree form a contiguous range of `pixels()`.
+    ///
+    /// \note Obtained with `ImageTree::freeze()`. The `ImageTree` must not be modified
+    /// (e.g. filtered) while the `FrozenTree` is in use.
+    class FrozenTree{
+        public:
+            /// \brief Constructor, freezing \p tree.
+            FrozenTree(const ImageTree &tree);
+
+            /// \brief Class destructor.
+            ~FrozenTree();
+
+            /// \brief The number of `Node`s in the tree.
+            int size() const;
+
+            /// \brief The `Node` at the preorder position \p i.
+            const Node *node(int i) const;
+
+            /// \brief The preorder position of a `Node`, -1 if not in the tree.
+            int index(const Node *n) const;
+
+            /// \brief The position of the parent (-1 for the root).
+            int parent(int i) const;
+
+            /// \brief The position of the ancestor \p depth steps above.
+            int ancestor(int i, int depth) const;
+
+            /// \brief The distance from the root.
+            int depth(int i) const;
+
+            /// \brief The level of the `Node`.
+            double level(int i) const;
+
+            /// \brief The gray level of the `Node`.
+            int grayLevel(int i) const;
+
+            /// \brief The number of pixels in the subtree.
+            int elementCount(int i) const;
+
+            /// \brief The number of `Node`s in the subtree.
+            int nodeCount(int i) const;
+
+            /// \brief Check if \p a is an ancestor of \p b (or \p b itself).
+            bool isAncestor(int a, int b) const;
+
+            /// \brief The Least Common Ancestor of two `Node`s.
+            int LCA(int a, int b) const;
+
+            /// \brief The range of `pixels()` holding the pixels of the subtree.
+            std::pair <int, int> pixelRange(int i) const;
+
+            /// \brief The range of `pixels()` holding the own pixels of the `Node`.
+            std::pair <int, int> ownPixelRange(int i) const;
+
+            /// \brief The pixels of the tree, ordered by the preorder position of their `Node`.
+            const std::vector <std::pair <int, int> > &pixels() const;
+
+            /// \brief The value of an `Attribute` of the `Node`.
+            template <class TAT>
+            const typename TAT::attribute_type &attribute(int i) const;
+
+        private:
+            std::vector <const Node *> order;
+            std::unordered_map <const Node *, int> positions;
+            std::vector <int> parentIdx;
+            std::vector <int> depths;
+            std::vector <int> subtreeNodes;
+            std::vector <int> pixelStart;
+            std::vector <int> subtreePixels;
+            std::vector <double> levels;
+            std::vector <int> grayLevels;
+            std::vector <std::pair <int, int> > allPixels;
+
+            /// \brief The values of the copied `Attribute`s, by name (each a
+            /// `std::vector` of `TypedAttribute::attribute_type`).
+            std::map <std::string, std::shared_ptr <const void> > attributeValues;
+
+            std::vector <int> firstVisit;
+            std::vector <int> tourNode;
+            std::vector <int> tourDepth;
+            detail::CompactRMQPlusMinusOne *rmq;
+
+            FrozenTree(const FrozenTree &);
+            FrozenTree &operator=(const FrozenTree &);
+
+            /// \brief Copy the values of the `Attribute` \p TAT of all the `Node`s.
+            template <class TAT>
+            void copyAttribute();
+
+            friend class ImageTree;
+    };
+}
+
+#include "frozentree.tpp"
+
+#endif // FROZENTREE_H
@@ -0,0 +1,53 @@
+/// \file structures/frozentree.tpp
+/// \author Petra Bosilj
+
+#ifndef TPP_FROZENTREE
+#define TPP_FROZENTREE
+
+#include "frozentree.h"
+
+#include "node.h"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace fl{
+
+/// \tparam TAT The `TypedAttribute` to read. Must have been copied when freezing
+/// (cf. `ImageTree::freeze()`).
+///
+/// \param i The preorder position of the `Node`.
+///
+/// \return The copy of the value made when freezing.
+template <class TAT>
+const typename TAT::attribute_type &FrozenTree::attribute(int i) const{
+    std::map <std::string, std::shared_ptr <const void> >::const_iterator it = this->attributeValues.find(TAT::name);
+    if (it == this->attributeValues.end()){
+        std::cerr << "Attribute " << TAT::name << " not copied when freezing the ImageTree, giving up." << std::endl;
+        std::exit(-2);
+    }
+    return (*(const std::vector <typename TAT::attribute_type> *)it->second.get())[i];
+}
+
+/// The values are read in preorder after all the `Attribute`s were calculated, so
+/// reading them does not trigger any calculation.
+///
+/// \tparam TAT The `TypedAttribute` to copy. Must be assigned to the tree.
+template <class TAT>
+void FrozenTree::copyAttribute(){
+    std::shared_ptr <std::vector <typename TAT::attribute_type> > values = std::make_shared <std::vector <typename TAT::attribute_type> >();
+    values->reserve(this->order.size());
+    for (int i=0, szi = this->order.size(); i < szi; ++i){
+        TAT *att = (TAT *)this->order[i]->getAttribute(TAT::name);
+        if (att == NULL){
+            std::cerr << "Attribute " << TAT::name << " not assigned to the ImageTree, giving up." << std::endl;
+            std::exit(-2);
+        }
+        values->push_back(att->value());
+    }
+    this->attributeValues[TAT::name] = values;
+}
+
+}
+
+#endif // TPP_FROZENTREE
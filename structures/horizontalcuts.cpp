@@ -0,0 +1,112 @@
+/// \file structures/horizontalcuts.cpp
+/// \author Petra Bosilj
+
+#include "horizontalcuts.h"
+
+#include "imagetree.h"
+#include "node.h"
+
+#include <algorithm>
+#include <limits>
+
+/// Orders the `Node`s top-down, lays out the pixels of every subtree contiguously
+/// (in preorder), and sorts the `Node`s by the level at which they are merged.
+///
+/// \param tree The `ImageTree` to index.
+fl::HorizontalCuts::HorizontalCuts(const ImageTree &tree){
+    tree.topDownOrder(this->order, this->parentIdx);
+    int szn = this->order.size();
+    int width = tree.treeWidth();
+
+    // the children of every Node are consecutive in the top-down order
+    std::vector <int> firstChild(szn, 0), childCount(szn, 0);
+    for (int i=1; i < szn; ++i)
+        if (childCount[this->parentIdx[i]]++ == 0)
+            firstChild[this->parentIdx[i]] = i;
+
+    this->subtreeBegin.resize(szn);
+    this->subtreeEnd.resize(szn);
+    this->pixels.reserve((size_t)width * tree.treeHeight());
+    // (Node, next child to visit)
+    std::vector <std::pair <int, int> > stack(1, std::make_pair(0, 0));
+    while (!stack.empty()){
+        int i = stack.back().first;
+        int &next = stack.back().second;
+        if (next == 0){ // entering the Node
+            this->subtreeBegin[i] = this->pixels.size();
+            const std::vector <std::pair <int, int> > &own = this->order[i]->getOwnElements();
+            for (int j=0, szj = own.size(); j < szj; ++j)
+                this->pixels.push_back(own[j].Y * width + own[j].X);
+        }
+        if (next < childCount[i])
+            stack.push_back(std::make_pair(firstChild[i] + next++, 0));
+        else{
+            this->subtreeEnd[i] = this->pixels.size();
+            stack.pop_back();
+        }
+    }
+
+    this->mergeLevel.resize(szn);
+    for (int i=0; i < szn; ++i)
+        this->mergeLevel[i] = this->order[i]->level();
+    for (int i = szn-1; i > 0; --i)
+        this->mergeLevel[this->parentIdx[i]] = std::max(this->mergeLevel[this->parentIdx[i]], this->mergeLevel[i]);
+
+    this->byLevel.resize(szn);
+    for (int i=0; i < szn; ++i)
+        this->byLevel[i] = i;
+    const std::vector <double> &mergeLevel = this->mergeLevel;
+    std::sort(this->byLevel.begin(), this->byLevel.end(), [&](int a, int b){
+        return mergeLevel[a] < mergeLevel[b] || (mergeLevel[a] == mergeLevel[b] && a < b);
+    });
+
+    this->labelImage = cv::Mat::zeros(tree.treeHeight(), width, CV_32SC1);
+    this->reset();
+}
+
+/// No `Node` merged: every pixel is a region on its own.
+void fl::HorizontalCuts::reset(){
+    int szn = this->order.size();
+    int *lab = this->labelImage.ptr<int>(0);
+    for (int p=0, szp = this->labelImage.rows * this->labelImage.cols; p < szp; ++p)
+        lab[p] = szn + p;
+    this->merged = 0;
+    this->current = -std::numeric_limits<double>::infinity();
+}
+
+/// When \p level is not lower than the level of the previous cut, the label image
+/// is updated in time proportional to the number of `Node`s merged in between and
+/// of the pixels changing the region. Otherwise it is recomputed.
+///
+/// \param level The level of the cut.
+///
+/// \return The label image (`CV_32S`). The region of a merged `Node` is labelled
+/// by the index of the `Node` in top-down order (cf. `region()`), and the pixel
+/// (x, y) forming a region on its own by `size + y*width + x`, where `size` is the
+/// number of `Node`s. Valid until the next call.
+const cv::Mat &fl::HorizontalCuts::cut(double level){
+    if (level < this->current)
+        this->reset();
+
+    int *lab = this->labelImage.ptr<int>(0);
+    for (int szn = this->order.size(); this->merged < szn && this->mergeLevel[this->byLevel[this->merged]] <= level; ++this->merged){
+        int i = this->byLevel[this->merged];
+        int p = this->parentIdx[i];
+        if (p >= 0 && this->mergeLevel[p] <= level)
+            continue; // relabelled with its parent
+        for (int j = this->subtreeBegin[i]; j < this->subtreeEnd[i]; ++j)
+            lab[this->pixels[j]] = i;
+    }
+    this->current = level;
+    return this->labelImage;
+}
+
+/// \copydetails cut()
+const cv::Mat &fl::HorizontalCuts::labels() const { return this->labelImage; }
+
+double fl::HorizontalCuts::level() const { return this->current; }
+
+/// \param label A label from the label image.
+fl::Node *fl::HorizontalCuts::region(int label) const{
+    return (label >= 0 && label < (int)this->order.size()) ? this->order[label] : NULL;
+}
@@ -0,0 +1,70 @@
+/// \file structures/horizontalcuts.h
+/// \author Petra Bosilj
+
+#ifndef HORIZONTALCUTS_H
+#define HORIZONTALCUTS_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace fl{
+
+    class ImageTree;
+    class Node;
+
+    /// \class HorizontalCuts
+    ///
+    /// \brief Produces the partitions of an `ImageTree` at a sequence of increasing
+    /// levels (horizontal cuts), updating the label image incrementally.
+    ///
+    /// A `Node` is merged at a level `t` when the levels of all the `Node`s in its
+    /// subtree are at most `t` (for alpha-trees, omega-trees and other partition
+    /// hierarchies, when its own level is at most `t`). The regions of the cut are
+    /// the highest merged `Node`s, and every pixel held by a `Node` which is not
+    /// merged is a region on its own.
+    ///
+    /// The `Node`s are sorted by the level at which they are merged. When the level
+    /// increases, only the `Node`s merged in between are visited, and only the pixels
+    /// changing the region are relabelled.
+    ///
+    /// \note Obtained with `ImageTree::horizontalCuts()`. The `ImageTree` must not be
+    /// modified (e.g. filtered) while the index is in use.
+    class HorizontalCuts{
+        public:
+            /// \brief Constructor, indexing \p tree.
+            HorizontalCuts(const ImageTree &tree);
+
+            /// \brief Update the label image to the cut at \p level.
+            const cv::Mat &cut(double level);
+
+            /// \brief The label image of the current cut.
+            const cv::Mat &labels() const;
+
+            /// \brief The level of the current cut.
+            double level() const;
+
+            /// \brief The `Node` of the region with the label \p label, `NULL` for
+            /// a single pixel.
+            Node *region(int label) const;
+
+        private:
+            std::vector <Node *> order;
+            std::vector <int> parentIdx;
+            std::vector <double> mergeLevel;
+            std::vector <int> byLevel;
+            int merged;
+            double current;
+
+            /// \brief The pixels (as `y*width + x`) in preorder of the `Node`s: the
+            /// subtree of `Node` i holds `pixels[subtreeBegin[i]]` to `pixels[subtreeEnd[i]-1]`.
+            std::vector <int> pixels;
+            std::vector <int> subtreeBegin, subtreeEnd;
+
+            cv::Mat labelImage;
+
+            void reset();
+    };
+}
+
+#endif // HORIZONTALCUTS_H
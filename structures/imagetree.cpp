@@ -11,6 +11,8 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <cmath>
+#include <algorithm>
 
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -23,10 +25,65 @@
 #include "noncompactnessattribute.h"
 #include "areaattribute.h"
 #include "momentsattribute.h"
+#include "treereconstruction.h"
+#include "frozentree.h"
+#include "levelancestors.h"
+#include "horizontalcuts.h"
+#include "scalesets.h"
+#include "../misc/parallel.h"
 
 
 using namespace fl;
 
+namespace fl{
+    namespace detail{
+
+        /// Fills the saliency map of `ImageTree::makeSaliencyMap()`: first the cells
+        /// between adjacent pixels, then (reading only those) the corners and the
+        /// border cells. Each pass runs in parallel over the pixel rows.
+        template <typename T>
+        void fillSaliencyMap(cv::Mat &map, const LevelAncestors &anc, const std::vector <int> &pixelIdx, int width, int height){
+            parallelFor(height, [&](int begin, int end){
+                for (int y = begin; y < end; ++y){
+                    const int *idx = &pixelIdx[(size_t)y * width];
+                    T *row = map.ptr<T>(y*2+1);
+                    for (int x=0; x < width-1; ++x)
+                        row[x*2+2] = cv::saturate_cast<T>(anc.level(anc.lowestCommonAncestor(idx[x], idx[x+1])));
+                    if (y == height-1)
+                        continue;
+                    const int *below = idx + width;
+                    T *next = map.ptr<T>(y*2+2);
+                    for (int x=0; x < width; ++x)
+                        next[x*2+1] = cv::saturate_cast<T>(anc.level(anc.lowestCommonAncestor(idx[x], below[x])));
+                }
+            });
+
+            parallelFor(height, [&](int begin, int end){
+                for (int y = begin; y < end; ++y){
+                    T *row = map.ptr<T>(y*2+1);
+                    for (int x=0; x < width-1; ++x){
+                        if (y == 0){
+                            map.ptr<T>(0)[x*2+2] = row[x*2+2];
+                            continue;
+                        }
+                        T *corner = map.ptr<T>(y*2);
+                        corner[x*2+2] = std::max(std::max(map.ptr<T>(y*2-1)[x*2+2], row[x*2+2]),
+                                                 std::max(corner[x*2+1], corner[x*2+3]));
+                        if (y == height-1)
+                            map.ptr<T>(y*2+2)[x*2+2] = row[x*2+2];
+                    }
+                    if (y == height-1)
+                        continue;
+                    T *next = map.ptr<T>(y*2+2);
+                    next[0] = next[1];
+                    if (width > 1)
+                        next[width*2] = next[width*2-1];
+                }
+            });
+        }
+    }
+}
+
 /// Organizes a previously linked collection of `Node`s into
 /// an `ImageTree`, allowing the user to manipulate all the
 /// `Node`s simultaneously as well as use the relations between
@@ -50,6 +107,8 @@ ImageTree::ImageTree(Node* root, std::pair< int, int > imDim)
     this->img = NULL;
     this->delOnDest = true;
     this->randomInit = false;
+    this->pixelMap = NULL;
+    this->indexPixels();
   //this->checkConstraints();
 }
 
@@ -61,6 +120,59 @@ ImageTree::~ImageTree(){
     if (this->_root != NULL && this->delOnDest){
         this->deallocateRoot(this->_root);
     }
+    else if (this->_root != NULL){ // surviving Nodes should not refer to the map
+        std::vector <fl::Node *> order;
+        std::vector <int> parentIdx;
+        this->topDownOrder(order, parentIdx);
+        for (int i=0, szi = order.size(); i < szi; ++i)
+            order[i]->_pixelMap = NULL;
+    }
+    delete this->pixelMap;
+}
+
+/// Numbers the `Node`s in preorder (iteratively), so that the subtree of every
+/// `Node` corresponds to the range [`_pre`, `_post`), and records the `Node`
+/// holding each pixel. The map is kept up to date when pixels move to other
+/// `Node`s during filtering, and the ranges remain nested, so that
+/// `Node::hasElement()` can be answered in O(1).
+void ImageTree::indexPixels(){
+    if (this->_root == NULL)
+        return;
+
+    this->pixelMap = new detail::PixelNodeMap();
+    this->pixelMap->width = this->width;
+    this->pixelMap->height = this->height;
+    this->pixelMap->nodes.assign((size_t)this->width * this->height, NULL);
+
+    std::vector <std::pair <fl::Node *, bool> > toProcess(1, std::make_pair(this->_root, false));
+    int pre = 0;
+    while (!toProcess.empty()){
+        fl::Node *cur = toProcess.back().first;
+        if (toProcess.back().second){ // subtree done
+            cur->_post = pre;
+            toProcess.pop_back();
+            continue;
+        }
+        toProcess.back().second = true;
+        cur->_pre = pre++;
+        cur->_pixelMap = this->pixelMap;
+        for (int i=0, szi = cur->_S.size(); i < szi; ++i)
+            this->pixelMap->nodes[(size_t)cur->_S[i].Y * this->width + cur->_S[i].X] = cur;
+        for (int i = cur->_children.size()-1; i >= 0; --i)
+            toProcess.push_back(std::make_pair(cur->_children[i], false));
+    }
+}
+
+/// \param x The column of the pixel.
+/// \param y The row of the pixel.
+///
+/// \return The `Node` holding the pixel (\p x, \p y) as own element (the
+/// smallest region containing the pixel), `NULL` if the pixel is outside of
+/// the image.
+Node *ImageTree::nodeAt(int x, int y) const{
+    if (this->pixelMap == NULL || x < 0 || y < 0 || x >= this->width || y >= this->height)
+        return NULL;
+    return this->pixelMap->nodes[(size_t)y * this->width + x];
 }
 
 /// Flip the settings regarding the destruction of
@@ -234,12 +346,12 @@ void ImageTree::printTree(std::ostream &outStream) const{
 ///
 /// \note To implement for non-grayscale images.
 void ImageTree::displayTree(const std::string &outPath) const{
-    cv::Mat img = cv::Mat::zeros(this->height, this->width, CV_8U);
+    cv::Mat img;
 
     if (outPath != "")
         std::cout << "Displaying tree with outPath " << outPath << std::endl;
 
-    this->_root->colorMe(img);
+    this->reconstructImage(img, CV_8U);
 
     cv::namedWindow("TreeReconstruction", cv::WINDOW_NORMAL);
     cv::imshow("TreeReconstruction", img);
@@ -276,6 +388,234 @@ void ImageTree::displayTree(const std::string &outPath) const{
     cv::destroyWindow("TreeReconstruction");
 }
 
+/// Calculates the values of all the `Attribute`s assigned to the tree which were
+/// not calculated yet, bottom-up, so that the values of the children are available.
+void ImageTree::calculateAllAttributes() const{
+    std::vector <fl::Node *> order;
+    std::vector <int> parentIdx;
+    this->topDownOrder(order, parentIdx);
+
+    for (int i = order.size()-1; i >= 0; --i){
+        std::map <std::string, Attribute *> &attributes = order[i]->attributes;
+        for (std::map <std::string, Attribute *>::iterator it = attributes.begin(); it != attributes.end(); ++it){
+            Attribute *att = it->second;
+            if (!att->valueSet){
+                att->ensureDefaultSettings();
+                att->calculateAttribute();
+                att->revertSettingsChanges();
+            }
+        }
+    }
+}
+
+/// The returned index answers the queries for the ancestor at a given depth,
+/// and for the first ancestor exceeding a given level difference or area, by
+/// binary lifting (cf. `LevelAncestors`).
+///
+/// \note The `ImageTree` must not be modified while the index is in use.
+std::shared_ptr <const LevelAncestors> ImageTree::levelAncestors() const{
+    return std::make_shared <const LevelAncestors>(*this);
+}
+
+/// The index is not shared: `HorizontalCuts::cut()` updates its label image.
+std::shared_ptr <HorizontalCuts> ImageTree::horizontalCuts() const{
+    return std::make_shared <HorizontalCuts>(*this);
+}
+
+/// A `Node` is merged at \p level when the levels of all the `Node`s in its
+/// subtree are at most \p level. Every region of the cut is a highest merged
+/// `Node`, and every pixel held by a `Node` which is not merged is a region
+/// on its own. The tree is not modified.
+///
+/// \param level The level of the cut.
+/// \param labels Output, the label image (`CV_32S`) with the regions numbered
+/// from 0 in the raster order of their first pixel.
+///
+/// \note For a sequence of increasing levels, use `horizontalCuts()`.
+void ImageTree::cutAtLevel(double level, cv::Mat &labels) const{
+    std::vector <Node *> order;
+    std::vector <int> parentIdx;
+    this->topDownOrder(order, parentIdx);
+    int szn = order.size();
+
+    std::vector <double> mergeLevel(szn);
+    for (int i=0; i < szn; ++i)
+        mergeLevel[i] = order[i]->level();
+    for (int i = szn-1; i > 0; --i)
+        mergeLevel[parentIdx[i]] = std::max(mergeLevel[parentIdx[i]], mergeLevel[i]);
+
+    // the highest merged ancestor of every Node, -1 if not merged
+    std::vector <int> region(szn, -1);
+    for (int i=0; i < szn; ++i){
+        int p = parentIdx[i];
+        if (p >= 0 && region[p] >= 0)
+            region[i] = region[p];
+        else if (mergeLevel[i] <= level)
+            region[i] = i;
+    }
+
+    this->labelRegions(order, region, labels);
+}
+
+/// \param energy The energy to minimise.
+std::shared_ptr <const ScaleSets> ImageTree::scaleSets(const CutEnergy &energy) const{
+    return std::make_shared <const ScaleSets>(*this, energy);
+}
+
+/// The cut is found by a single bottom-up pass: a `Node` is a region when its
+/// energy is not larger than the optimal energy of its partition into the optimal
+/// cuts of its children and its own pixels (regions on their own). The tree is not
+/// modified.
+///
+/// \param lambda The weight of the complexity.
+/// \param energy The energy to minimise.
+/// \param labels Output, the label image (`CV_32S`) with the regions numbered
+/// from 0 in the raster order of their first pixel.
+///
+/// \return The energy of the optimal cut.
+///
+/// \note To sweep over \p lambda, use `scaleSets()`.
+double ImageTree::optimalCut(double lambda, const CutEnergy &energy, cv::Mat &labels) const{
+    std::vector <Node *> order;
+    std::vector <int> parentIdx;
+    this->topDownOrder(order, parentIdx);
+    int szn = order.size();
+
+    std::vector <double> best(szn, 0.0);
+    std::vector <char> isRegion(szn, false);
+    for (int i = szn-1; i >= 0; --i){
+        best[i] += order[i]->getOwnElements().size() * lambda * energy.pixelComplexity;
+        double self = energy.fidelity(order[i]) + lambda * energy.complexity(order[i]);
+        if (self <= best[i]){
+            best[i] = self;
+            isRegion[i] = true;
+        }
+        if (parentIdx[i] >= 0)
+            best[parentIdx[i]] += best[i];
+    }
+
+    std::vector <int> region(szn, -1);
+    for (int i=0; i < szn; ++i){
+        int p = parentIdx[i];
+        if (p >= 0 && region[p] >= 0)
+            region[i] = region[p];
+        else if (isRegion[i])
+            region[i] = i;
+    }
+
+    this->labelRegions(order, region, labels);
+    return best[0];
+}
+
+/// \param order The `Node`s in top-down order (cf. `topDownOrder()`).
+/// \param region The region of every `Node` in \p order, -1 for the `Node`s whose
+/// own pixels are regions on their own.
+/// \param labels Output, the label image (`CV_32S`) with the regions numbered
+/// from 0 in the raster order of their first pixel.
+void ImageTree::labelRegions(const std::vector <Node *> &order, const std::vector <int> &region, cv::Mat &labels) const{
+    int szn = order.size();
+    labels = cv::Mat(this->treeHeight(), this->treeWidth(), CV_32SC1, cv::Scalar(-1));
+    for (int i=0; i < szn; ++i){
+        const std::vector <std::pair <int, int> > &own = order[i]->getOwnElements();
+        for (int j=0, szj = own.size(); j < szj; ++j)
+            labels.at<int>(own[j].Y, own[j].X) = region[i] >= 0 ? region[i] : szn;
+    }
+
+    // renumber in raster order, single pixels are marked by szn
+    std::vector <int> renumber(szn, -1);
+    int next = 0;
+    for (int y = 0; y < labels.rows; ++y){
+        int *row = labels.ptr<int>(y);
+        for (int x = 0; x < labels.cols; ++x){
+            if (row[x] == szn)
+                row[x] = next++;
+            else if (row[x] >= 0){
+                if (renumber[row[x]] < 0)
+                    renumber[row[x]] = next++;
+                row[x] = renumber[row[x]];
+            }
+        }
+    }
+}
+
+/// Fills every pixel with the gray level of the `Node` containing it (one
+/// channel per band of `Node::hyperGraylevel()` when it is set). The image
+/// is filled in parallel blocks of rows (cf. `TreeReconstruction`).
+///
+/// \param out Output, the reconstructed image.
+/// \param depth The depth of \p out (any `cv::Mat` depth).
+void ImageTree::reconstructImage(cv::Mat &out, int depth) const{
+    TreeReconstruction(*this).reconstruct(out, depth);
+}
+
+/// Calculates, for each of the size \p measures, the granulometric curves with the
+/// contents of `calculateGranulometryHistogram()`: the count curve (rule 0, one per
+/// region) and the volume curve (rule 1, area times the contrast with the parent,
+/// for all regions except the root), both indexed by the size of the region.
+///
+/// The areas and bounding boxes of all the regions are obtained in one bottom-up
+/// pass, without assigning any `Attribute` to the tree. On a max-tree (min-tree),
+/// the curves correspond to the granulometry by attribute openings (closings) for
+/// every possible scale.
+///
+/// \param measures The size measures for which to calculate the curves.
+/// \param counts Output, the count curve for every measure in \p measures.
+/// \param volumes Output, the volume curve for every measure in \p measures.
+void ImageTree::sizeGranulometry(const std::vector <sizeMeasure> &measures,
+                                 std::vector <std::map <double, long long> > &counts,
+                                 std::vector <std::map <double, long long> > &volumes) const{
+    std::vector <fl::Node *> order;
+    std::vector <int> parentIdx;
+    this->topDownOrder(order, parentIdx);
+
+    int szn = order.size();
+    std::vector <int> area(szn, 0);
+    std::vector <int> minx(szn, this->width), maxx(szn, -1), miny(szn, this->height), maxy(szn, -1);
+
+    for (int i = szn-1; i >= 0; --i){
+        const std::vector <std::pair <int, int> > &S = order[i]->_S;
+        area[i] += S.size();
+        for (int j=0, szj = S.size(); j < szj; ++j){
+            minx[i] = std::min(minx[i], S[j].first);
+            maxx[i] = std::max(maxx[i], S[j].first);
+            miny[i] = std::min(miny[i], S[j].second);
+            maxy[i] = std::max(maxy[i], S[j].second);
+        }
+        int p = parentIdx[i];
+        if (p >= 0){
+            area[p] += area[i];
+            minx[p] = std::min(minx[p], minx[i]);
+            maxx[p] = std::max(maxx[p], maxx[i]);
+            miny[p] = std::min(miny[p], miny[i]);
+            maxy[p] = std::max(maxy[p], maxy[i]);
+        }
+    }
+
+    int szm = measures.size();
+    counts.assign(szm, std::map <double, long long>());
+    volumes.assign(szm, std::map <double, long long>());
+
+    for (int i=0; i < szn; ++i){
+        int w = maxx[i] - minx[i] + 1;
+        int h = maxy[i] - miny[i] + 1;
+        int p = parentIdx[i];
+        long long volume = (p < 0) ? 0 : area[i] * std::abs((long long)order[i]->_grayLevel - order[p]->_grayLevel);
+
+        for (int m=0; m < szm; ++m){
+            double size;
+            switch (measures[m]){
+                case sizeMeasure::area:     size = area[i]; break;
+                case sizeMeasure::diagonal: size = std::sqrt((double)w*w + (double)h*h); break;
+                case sizeMeasure::boxSide:
+                default:                    size = std::min(w, h); break;
+            }
+            ++counts[m][size];
+            if (p >= 0)
+                volumes[m][size] += volume;
+        }
+    }
+}
+
 /// Returns a list of all the leaf `Node`s present in this
 /// `ImageTree`.
 ///
@@ -304,45 +644,33 @@ void ImageTree::getLeaves(std::vector <fl::Node *> &leaves) const{
 /// tree" (2008)
 ///
 /// Calculates the extinction values (according to the standard definition)
-/// or more precisely, `RegionDynamicsAttribute` assigned to each node.
+/// for the dynamics, i.e. the contrast between each leaf and the level at
+/// which its branch (followed through the children with the largest
+/// `RegionDynamicsAttribute`) merges with a more contrasted one. Runs in
+/// linear time and does not modify the `Node`s.
 ///
 /// \param leafExt An output vector to be filled with extinction values
 /// associated to each leaf `Node` of the tree.
+///
+/// \note See `getExtinctions()` for the extinction values of any
+/// increasing `Attribute` for all the `Node`s.
 void ImageTree::getLeafExtinctions(std::vector <std::pair <int, fl::Node *> > &leafExt) const{
     leafExt.clear();
-    std::vector <fl::Node *> leaves;
-    this->getLeaves(leaves);
     this->addAttributeToTree<fl::RegionDynamicsAttribute>(new fl::RegionDynamicsSettings());
-    int treeHeight = ((fl::RegionDynamicsAttribute*)this->_root->getAttribute(fl::RegionDynamicsAttribute::name))->value();
-    for (int i=0, szi = leaves.size(); i < szi; ++i){
-        int extinction = treeHeight;
-        fl::Node *par = leaves[i]->parent();
-        for(int parHeight = ((fl::RegionDynamicsAttribute*)par->getAttribute(fl::RegionDynamicsAttribute::name))->value(),
-            levelDiff = std::abs(leaves[i]->level() - par->level()); // note: no abs in the original; only for one direction trees
-            parHeight <= levelDiff;
-            par = par->parent(),
-            parHeight = ((fl::RegionDynamicsAttribute*)par->getAttribute(fl::RegionDynamicsAttribute::name))->value(),
-            levelDiff = std::abs(leaves[i]->level() - par->level())){
-            if (par->visited && par->_children.size() > 1 && parHeight == levelDiff)
-                break;
-            par->visited = true;
-            if (par->isRoot())
-                break;
-        }
-        extinction = std::abs(leaves[i]->level() - par->level());
-        leafExt.emplace_back(extinction, leaves[i]);
-    }
 
-    this->deleteAttributeFromTree<fl::RegionDynamicsAttribute>();
+    std::vector <fl::Node *> order;
+    std::vector <int> parentIdx, branchHead;
+    this->extinctionBranches<fl::RegionDynamicsAttribute>(order, parentIdx, branchHead);
 
-    std::stack <fl::Node *> nodeStack;
-    nodeStack.push(this->_root);
-    for (fl::Node *cur; !nodeStack.empty();){
-        cur = nodeStack.top();
-        nodeStack.pop();
-        cur->visited = false;
-        for (int i=0, szi = cur->_children.size(); i < szi; ++i) nodeStack.push(cur->_children[i]);
+    for (int i=0, szi = order.size(); i < szi; ++i){
+        if (!order[i]->_children.empty())
+            continue;
+        int head = branchHead[i];
+        const fl::Node *saddle = (parentIdx[head] < 0) ? order[head] : order[parentIdx[head]];
+        leafExt.emplace_back((int)std::abs(order[i]->level() - saddle->level()), order[i]);
     }
+
+    this->deleteAttributeFromTree<fl::RegionDynamicsAttribute>();
     return;
 }
 
@@ -416,12 +744,7 @@ void ImageTree::markAllPatches(cv::Mat &image) const{
 /// \param value The RGB value of the flat color with which to draw the
 /// regions.
 void ImageTree::markAllPatches(cv::Mat &image, const cv::Vec3b &value) const{
-    const std::vector <Node *> &ch = this->_root->_children;
-    for (int i=0, szi = ch.size(); i < szi; ++i){
-        if (ch[i] != NULL){
-            ch[i]->colorSolid(image, value);
-        }
-    }
+    TreeReconstruction(*this).markNodes(image, this->_root->_children, value);
 }
 
 /// \copydetails markAllPatches(cv::Mat &image)
@@ -429,12 +752,7 @@ void ImageTree::markAllPatches(cv::Mat &image, const cv::Vec3b &value) const{
 /// \param value The intensity value of the flat grayvalue with which to draw the
 /// regions.
 void ImageTree::markAllPatches(cv::Mat &image, const cv::Scalar &value) const{
-    const std::vector <Node *> &ch = this->_root->_children;
-    for (int i=0, szi = ch.size(); i < szi; ++i){
-        if (ch[i] != NULL){
-            ch[i]->colorSolid(image, value);
-        }
-    }
+    TreeReconstruction(*this).markNodes(image, this->_root->_children, value);
 }
 
 /// In-paints all the given `Node`s. Meant to be used to display selected
@@ -457,10 +775,7 @@ void ImageTree::markSelectedNodes(cv::Mat &image,
 void ImageTree::markSelectedNodes(cv::Mat &image,
                                   const std::vector <Node *> &toMark,
                                   const cv::Vec3b &value) const{
-    for (int i=0, szi = toMark.size(); i < szi; ++i)
-        if (toMark[i] != NULL){
-            toMark[i]->colorSolid(image, value);
-        }
+    TreeReconstruction(*this).markNodes(image, toMark, value);
 }
 
 /// \copydetails markSelectedNodes(cv::Mat &image, const std::vector <Node *> &toMark)
@@ -470,39 +785,23 @@ void ImageTree::markSelectedNodes(cv::Mat &image,
 void ImageTree::markSelectedNodes(cv::Mat &image,
                                   const std::vector <Node *> &toMark,
                                   const cv::Scalar &value) const{
-    for (int i=0, szi = toMark.size(); i < szi; ++i)
-        if (toMark[i] != NULL){
-            toMark[i]->colorSolid(image, value);
-        }
+    TreeReconstruction(*this).markNodes(image, toMark, value);
 }
 
 /// Preprocess the tree to be able to query Least Common Ancestor of any two `Node`s in O(1)
+///
+/// Records the Euler tour of the tree (iteratively) and builds a
+/// `detail::CompactRMQPlusMinusOne` over the depths along the tour. Only the
+/// `Node`s along the tour, the first visit of every `Node` and of every pixel are
+/// kept afterwards.
 void ImageTree::LCAPreprocess(void){
     if (this->LCAPreprocessed)
         return;
 
-    // fill the invLevel and representative matrix
     this->representatives = new cv::Mat(cv::Mat::zeros(this->height, this->width, CV_32SC1));
-    eulersTour(this->root());
-//    std::cout << "SIZE OF TOUR:" << this->rootDistTour.size() << std::endl;
-//    std::cout << "ROOT DIST: " << std::endl;
-//    for (int i=0; i < this->rootDistTour.size(); ++i)
-//        std::cout << this->rootDistTour[i] << " ";
-//    std::cout << std::endl;
-//    std::cout << "LEVEL: " << std::endl;
-//    for (int i=0; i < this->rootDistTour.size(); ++i)
-//        std::cout << this->levelTour[i] << " ";
-//    std::cout << std::endl;
-
-
-//    for (int y = 0; y < this->height; ++y){
-//        for (int x=0; x < this->width; ++x)
-//            std::cout << detail::getCvMatElem(*(this->representatives), x, y) << " ";
-//        std::cout << std::endl;
-//    }
-
-
-    this->rmq = new detail::RMQPlusMinusOne<int>(this->rootDistTour);
+    std::vector <int> depthTour;
+    this->eulersTour(depthTour);
+    this->rmq = new detail::CompactRMQPlusMinusOne(depthTour);
 
     this->LCAPreprocessed = true;
 }
@@ -510,118 +809,166 @@ void ImageTree::LCAPreprocess(void){
 /// Free the structures used to calculate LCA
 void ImageTree::LCAFree(void){
     if (this->LCAPreprocessed){
-        this->rootDistTour.clear();
-        this->levelTour.clear();
+        std::vector <const Node *>().swap(this->nodeTour);
+        std::unordered_map <const Node *, int>().swap(this->tourPositions);
         delete this->representatives;
         delete this->rmq;
         this->LCAPreprocessed = false;
     }
 }
 
-void ImageTree::makeSaliencyMap(cv::Mat &saliency_map) const{
-    if (!this->LCAPreprocessed)
-        return;
-
-    saliency_map = cv::Mat::zeros(this->height * 2 + 1, this->width * 2 + 1, CV_8U); // see if image type needs changing
-
-//    std::cout << "Constructing saliency map" << std::endl;
-
-    for (int y=0; y < this->height; ++y){
-        for (int x=0; x < this->width ; ++x){
-            int firstIndex = detail::getCvMatElem(*(this->representatives), x, y) - 1;
-//            std::cout << "(x,y): (" << x << " " << y << ") ";
-
-            int secondIndex;
-            if (x < (this->width - 1)){
-                secondIndex = detail::getCvMatElem(*(this->representatives), x+1, y) - 1;
-//                std::cout << " -- (" << x+1 << " " << y << ") ";
-//                std::cout << "(f-s) " << firstIndex << "-" << secondIndex << " " << (*(this->rmq))(firstIndex, secondIndex) << " ";
-//                std::cout << " (" << x*2+1+1 << " " << y*2+1 << ") = " << this->levelTour[(*(this->rmq))(firstIndex, secondIndex)] << " ";
-                saliency_map.at<uchar>(y*2+1,x*2+1+1) = this->levelTour[(*(this->rmq))(firstIndex, secondIndex)];
-                if (y == 0){
-                    saliency_map.at<uchar>(0, x*2+1+1) = saliency_map.at<uchar>(y*2+1,x*2+1+1);
-                }
-                else{
-                    uchar up, down, left, right;
-                    up = detail::getCvMatElem(saliency_map,    x*2+1+1,  y*2-1);
-                    down = detail::getCvMatElem(saliency_map,  x*2+1+1,  y*2+1);
-                    left = detail::getCvMatElem(saliency_map,  x*2+1+1-1,y*2);
-                    right = detail::getCvMatElem(saliency_map, x*2+1+1+1,y*2);
-
-                    saliency_map.at<uchar>(y*2, x*2+1+1) = std::max(std::max(up, down), std::max(left, right));
-                    if (y == (this->height-1))
-                        saliency_map.at<uchar>(y*2+1+1, x*2+1+1) = saliency_map.at<uchar>(y*2+1,x*2+1+1);
-                }
-            }
-
+/// Needs `LCAPreprocess()`. Answered in O(1).
+///
+/// \param first The first `Node`, part of the `ImageTree`.
+/// \param second The second `Node`, part of the `ImageTree`.
+///
+/// \return The lowest `Node` having both \p first and \p second in its subtree,
+/// `NULL` if one of them is not in the tree.
+const Node* ImageTree::LCA(const Node *first, const Node *second) const{
+    this->checkLCAPreprocessed();
+    std::unordered_map <const Node *, int>::const_iterator a = this->tourPositions.find(first);
+    std::unordered_map <const Node *, int>::const_iterator b = this->tourPositions.find(second);
+    if (a == this->tourPositions.end() || b == this->tourPositions.end())
+        return NULL;
+    return this->nodeTour[(*this->rmq)(a->second, b->second)];
+}
 
+/// Needs `LCAPreprocess()`. The queries are answered in parallel.
+///
+/// \param pairs The pairs of `Node`s of the `ImageTree`.
+/// \param ancestors Output, the `LCA()` of every pair in \p pairs.
+void ImageTree::LCA(const std::vector <std::pair <const Node *, const Node *> > &pairs,
+                    std::vector <const Node *> &ancestors) const{
+    this->checkLCAPreprocessed();
+    ancestors.resize(pairs.size());
+    detail::parallelFor(pairs.size(), [&](int begin, int end){
+        for (int i=begin; i < end; ++i)
+            ancestors[i] = this->LCA(pairs[i].first, pairs[i].second);
+    }, 1024);
+}
 
-            if (y < (this->height - 1)){
-                secondIndex = detail::getCvMatElem(*(this->representatives), x, y+1) - 1;
-//                std::cout << " -- (" << x << " " << y+1 << ") ";
-//                std::cout << "(f-s) " << firstIndex << "-" << secondIndex << " " << (*(this->rmq))(firstIndex, secondIndex) << " ";
-//                std::cout << " (" << x*2+1 << " " << y*2+1+1 << ") = " << this->levelTour[(*(this->rmq))(firstIndex, secondIndex)] << " ";
-                saliency_map.at<uchar>(y*2+1+1,x*2+1) = this->levelTour[(*(this->rmq))(firstIndex, secondIndex)];
-                if (x == 0){
-                    saliency_map.at<uchar>(y*2+1+1, 0) = saliency_map.at<uchar>(y*2+1+1,x*2+1);
-                }
-                else if (x == (this->width-1)){
-                    saliency_map.at<uchar>(y*2+1+1, x*2+1+1) = saliency_map.at<uchar>(y*2+1+1,x*2+1);
-                }
+/// Needs `LCAPreprocess()`. The queries are answered in parallel, in O(1) each.
+///
+/// \param pixelPairs The pairs of pixels, given as (x, y) coordinates.
+/// \param ancestors Output, for every pair in \p pixelPairs, the `LCA()` of the
+/// `Node`s holding the two pixels as own elements (`NULL` if a pixel is outside of
+/// the image).
+void ImageTree::pixelLCA(const std::vector <std::pair <std::pair <int, int>, std::pair <int, int> > > &pixelPairs,
+                         std::vector <const Node *> &ancestors) const{
+    this->checkLCAPreprocessed();
+    ancestors.resize(pixelPairs.size());
+    const cv::Mat &rep = *this->representatives;
+    int width = this->width, height = this->height;
+    detail::parallelFor(pixelPairs.size(), [&](int begin, int end){
+        for (int i=begin; i < end; ++i){
+            const std::pair <int, int> &p = pixelPairs[i].first, &q = pixelPairs[i].second;
+            if (p.X < 0 || p.Y < 0 || p.X >= width || p.Y >= height ||
+                q.X < 0 || q.Y < 0 || q.X >= width || q.Y >= height){
+                ancestors[i] = NULL;
+                continue;
             }
-
-
-//            std::cout << "   " << std::endl;
+            ancestors[i] = this->nodeTour[(*this->rmq)(rep.at<int>(p.Y, p.X) - 1, rep.at<int>(q.Y, q.X) - 1)];
         }
-//        std::cout << std::endl;
-    }
-
-//    std::cout << "Constructed saliency map" << std::endl;
+    }, 1024);
 }
 
-// private methods start here
+/// The map has a cell for every pixel, every pair of adjacent pixels and every
+/// corner between them: (2*`treeHeight()`+1) x (2*`treeWidth()`+1). The cell
+/// between two adjacent pixels holds the level of the lowest common ancestor of
+/// their `Node`s, i.e. the level at which the two pixels are merged. An interior
+/// corner holds the maximum of the four cells around it, and the border cells
+/// copy the closest cell between pixels. The pixel cells are 0.
+///
+/// Does not need `LCAPreprocess()`. The `Node`s of the adjacent pixels are joined
+/// by a short walk up the tree (binary lifting in the rare longer cases), so the
+/// map is built in time close to linear in the number of pixels, in parallel over
+/// the rows.
+///
+/// \param saliency_map Output, the saliency (ultrametric contour) map.
+/// \param depth The depth of \p saliency_map: `CV_8U`, `CV_16U`, `CV_32F`
+/// or `CV_64F`. The levels are saturated to the range of the type.
+void ImageTree::makeSaliencyMap(cv::Mat &saliency_map, int depth) const{
+    if (this->_root == NULL)
+        return;
+    if (depth != CV_8U && depth != CV_16U && depth != CV_32F && depth != CV_64F){
+        std::cerr << "The saliency map can only be of depth CV_8U, CV_16U, CV_32F or CV_64F." << std::endl;
+        std::exit(-1);
+    }
 
-void ImageTree::eulersTour(const Node *current, int depth){
-    this->rootDistTour.emplace_back(depth);
-    this->levelTour.emplace_back(current->level());
-    const std::vector <std::pair <int, int> > &pixels = current->getOwnElements();
-    for (int i=0, szi = pixels.size(); i < szi; ++i){
-        representatives->at<int>(pixels[i].Y, pixels[i].X) = this->levelTour.size();
+    LevelAncestors anc(*this);
+    std::vector <int> pixelIdx((size_t)this->width * this->height, 0);
+    for (int i=0, szi = anc.size(); i < szi; ++i){
+        const std::vector <std::pair <int, int> > &pixels = anc.node(i)->getOwnElements();
+        for (int j=0, szj = pixels.size(); j < szj; ++j)
+            pixelIdx[(size_t)pixels[j].Y * this->width + pixels[j].X] = i;
     }
-    for (int i=0, szi = current->_children.size(); i < szi; ++i){
-        eulersTour(current->_children[i], depth+1);
-        this->rootDistTour.emplace_back(depth);
-        this->levelTour.emplace_back(current->level());
+
+    saliency_map = cv::Mat::zeros(this->height * 2 + 1, this->width * 2 + 1, CV_MAKETYPE(depth, 1));
+    switch (depth){
+        case CV_8U:  detail::fillSaliencyMap<uchar>(saliency_map, anc, pixelIdx, this->width, this->height); break;
+        case CV_16U: detail::fillSaliencyMap<ushort>(saliency_map, anc, pixelIdx, this->width, this->height); break;
+        case CV_32F: detail::fillSaliencyMap<float>(saliency_map, anc, pixelIdx, this->width, this->height); break;
+        default:     detail::fillSaliencyMap<double>(saliency_map, anc, pixelIdx, this->width, this->height); break;
     }
 }
 
-void ImageTree::reconstructUO(const std::vector< int > &res,
-                              const std::vector<int> &scl,
-                              cv::Mat &residual, cv::Mat &scale,
-                              std::pair<fl::Node *, int> &current) const{
+// private methods start here
 
-    const fl::Node* cur = current.first;
-    if (cur == this->root()){
-        residual = cv::Mat(this->treeHeight(), this->treeWidth(), CV_16U, cv::Scalar(0));
-        scale = cv::Mat(this->treeHeight(), this->treeWidth(), CV_16U, cv::Scalar(0));
+/// Records the Euler tour of the tree iteratively: every `Node` is listed when
+/// it is entered and again after each of its children. The first visit of every
+/// `Node` goes to `tourPositions`, and that of the `Node` holding each pixel (plus
+/// one) to `representatives`.
+///
+/// \param depthTour Output, the depth of every `Node` along the tour.
+void ImageTree::eulersTour(std::vector <int> &depthTour){
+    this->nodeTour.clear();
+    this->tourPositions.clear();
+    depthTour.clear();
+
+    // (Node, next child to visit)
+    std::vector <std::pair <const Node *, int> > stack(1, std::make_pair((const Node *)this->_root, 0));
+    while (!stack.empty()){
+        const Node *cur = stack.back().first;
+        int &next = stack.back().second;
+        if (next == 0){ // entering the Node
+            this->tourPositions[cur] = this->nodeTour.size();
+            const std::vector <std::pair <int, int> > &pixels = cur->getOwnElements();
+            for (int i=0, szi = pixels.size(); i < szi; ++i)
+                this->representatives->at<int>(pixels[i].Y, pixels[i].X) = this->nodeTour.size() + 1;
+        }
+        this->nodeTour.push_back(cur);
+        depthTour.push_back(stack.size() - 1);
 
-        //double min, max;
-        //cv::minMaxLoc(residual, &min, &max);
-        //std::cout << "Residual: min - " << min << " max - " << max << std::endl;
+        if (next < (int)cur->_children.size())
+            stack.push_back(std::make_pair((const Node *)cur->_children[next++], 0));
+        else
+            stack.pop_back();
     }
+}
 
-    const std::vector <fl::pxCoord > &elems = cur->getOwnElements();
-    for (int i=0, szi = elems.size(); i < szi; ++i){
-
-        scale.at<unsigned short>(elems[i].Y, elems[i].X) = (unsigned short)scl[current.second];
-        residual.at<unsigned short>(elems[i].Y, elems[i].X) = (unsigned short)res[current.second];
+/// Exits with an error message if `LCAPreprocess()` was not called.
+void ImageTree::checkLCAPreprocessed() const{
+    if (!this->LCAPreprocessed){
+        std::cerr << "LCA queries on an ImageTree need ImageTree::LCAPreprocess() first." << std::endl;
+        std::exit(-1);
     }
-    //std::cout << res[current.second] << std::endl;
+}
 
-    for (int i=0, szi = cur->_children.size(); i < szi; ++i){
-        ++current.second;
-        current.first = cur->_children[i];
-        this->reconstructUO(res, scl, residual, scale, current);
+/// Orders the `Node`s of the tree top-down (breadth-first), so that every
+/// `Node` is placed after its parent.
+///
+/// \param order Output, the `Node`s of the tree in top-down order.
+/// \param parentIdx Output, the index of the parent of each `Node` in \p order (-1 for the root).
+void ImageTree::topDownOrder(std::vector <fl::Node *> &order, std::vector <int> &parentIdx) const{
+    order.assign(1, this->_root);
+    parentIdx.assign(1, -1);
+
+    for (int i=0; i < (int)order.size(); ++i){
+        const std::vector <fl::Node *> &chi = order[i]->_children;
+        for (int j=0, szj = chi.size(); j < szj; ++j){
+            order.push_back(chi[j]);
+            parentIdx.push_back(i);
+        }
     }
 }
 
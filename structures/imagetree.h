@@ -12,11 +12,29 @@
 #include "../misc/commontreedetail.h"
 
 #include <set>
+#include <map>
+#include <memory>
+#include <unordered_map>
 
 namespace fl {
 
 class AttributeSettings;
 class PatternSpectra2DSettings;
+class FrozenTree;
+class LevelAncestors;
+class HorizontalCuts;
+class CutEnergy;
+class ScaleSets;
+class PatternSpectrumND;
+class Binning;
+
+/// \brief Size measures of the regions, used by `ImageTree::sizeGranulometry()`.
+/// All of them are increasing.
+///     - area: the number of pixels.
+///     - diagonal: the diagonal of the bounding box (cf. `DiagonalMinimumAttribute`).
+///     - boxSide: the shorter side of the bounding box, i.e. the side of the largest
+///       square structuring element which could fit in the bounding box.
+enum class sizeMeasure {area, diagonal, boxSide};
 
 /// \class ImageTree
 ///
@@ -92,9 +110,41 @@ class ImageTree {
         //void displayTree(const std::string &outPath = "/home/petra/Programming/Trees/filtest.png") const;
         void displayTree(const std::string &outPath = "") const;
 
+        /// \brief Precompute all the lazily calculated values and return an immutable,
+        /// thread-safe handle, holding copies of the values of the `Attribute`s \p TATs.
+        template<class... TATs>
+        std::shared_ptr <const FrozenTree> freeze() const;
+
+        /// \brief Build an index answering level-ancestor queries in O(log n).
+        std::shared_ptr <const LevelAncestors> levelAncestors() const;
+
+        /// \brief Build an index producing the horizontal cuts at increasing levels incrementally.
+        std::shared_ptr <HorizontalCuts> horizontalCuts() const;
+
+        /// \brief Label the regions of the horizontal cut at a level.
+        void cutAtLevel(double level, cv::Mat &labels) const;
+
+        /// \brief Build the optimal cuts of the tree for all the weights of the complexity.
+        std::shared_ptr <const ScaleSets> scaleSets(const CutEnergy &energy) const;
+
+        /// \brief Label the regions of the cut minimising an energy, for a given weight of the complexity.
+        double optimalCut(double lambda, const CutEnergy &energy, cv::Mat &labels) const;
+
+        /// \brief Reconstruct the image represented by `ImageTree`.
+        void reconstructImage(cv::Mat &out, int depth = CV_8U) const;
+
+        /// \brief Get the `Node` holding a pixel as own element.
+        Node *nodeAt(int x, int y) const;
+
         /// \brief Get a list of all the leaf `Node`s from the `ImageTree`.
         void getLeaves(std::vector <fl::Node *> &leaves) const;
 
+        /// \brief Calculate the count and volume granulometric curves for several size
+        /// measures in a single pass over the `ImageTree`.
+        void sizeGranulometry(const std::vector <sizeMeasure> &measures,
+                              std::vector <std::map <double, long long> > &counts,
+                              std::vector <std::map <double, long long> > &volumes) const;
+
         /// \brief Calculate extinction values for all the leaves in the tree.
         void getLeafExtinctions(std::vector <std::pair <int, fl::Node *> > &leafExt) const;
 
@@ -129,11 +179,19 @@ class ImageTree {
         void LCAFree(void);
 
         /// \brief Construct a saliency map image from the tree.
-        void makeSaliencyMap(cv::Mat &saliency_map) const;
+        void makeSaliencyMap(cv::Mat &saliency_map, int depth = CV_8U) const;
 
 
         /// \brief Return the Least Common Ancestor of two `Node`s
-        const Node* LCA(Node *first, Node *second);
+        const Node* LCA(const Node *first, const Node *second) const;
+
+        /// \brief Return the Least Common Ancestor of every pair of `Node`s.
+        void LCA(const std::vector <std::pair <const Node *, const Node *> > &pairs,
+                 std::vector <const Node *> &ancestors) const;
+
+        /// \brief Return the Least Common Ancestor of the `Node`s holding every pair of pixels.
+        void pixelLCA(const std::vector <std::pair <std::pair <int, int>, std::pair <int, int> > > &pixelPairs,
+                      std::vector <const Node *> &ancestors) const;
 
         /// \brief Perform a filtering on `ImageTree` by evaluating a
         /// predicate on the values of `Node::level()`.
@@ -141,6 +199,11 @@ class ImageTree {
         template<class Function>
         void filterTreeByLevelPredicate(Function predicate, int rule = 0, Node *_root = NULL);
 
+        /// \brief Render the image which would be obtained by filtering `ImageTree` with
+        /// a predicate on the values of `Node::level()`, without modifying the tree.
+        template<class Function>
+        void filteredImageByLevelPredicate(Function predicate, cv::Mat &out, int rule = 0) const;
+
 //        /// \brief Get a leaf `Node` from the `ImageTree` containing a pixel.
 //        Node *lowestPixelOf(pxCoord px) const;
 
@@ -180,6 +243,15 @@ class ImageTree {
         template<class ATT>
         void calculateGranulometryHistogram(std::map<double, int> &GCF, int rule = 0, const fl::Node *_root = NULL) const;
 
+        /// \brief Get the granulometric curve for the given `Attribute` for every distinct
+        /// value, with 64-bit content.
+        template<class ATT>
+        void calculateGranulometryHistogram(std::vector <std::pair <double, long long> > &GCF, int rule = 0, const fl::Node *_root = NULL) const;
+
+        /// \brief Get the granulometric curve for the given `Attribute`, accumulated into bins.
+        template<class ATT>
+        void calculateGranulometryHistogram(const std::vector <double> &binLimits, std::vector <long long> &GCF, int rule = 0, const fl::Node *_root = NULL) const;
+
         /// \brief Output the value of a selected `Attribute` for the given vector of `Node`s.
         template <class AT>
         void writeAttributesToFile(const std::vector <Node *> &nodes, std::ostream &out) const;
@@ -214,6 +286,16 @@ class ImageTree {
         template<class TAT, class Function>
         void filterTreeByAttributePredicate(Function predicate, int rule = 0, Node *_root = NULL);
 
+        /// \brief Render the image which would be obtained by filtering `ImageTree` with
+        /// a predicate on the values of an `Attribute`, without modifying the tree.
+        template<class TAT, class Function>
+        void filteredImageByAttributePredicate(Function predicate, cv::Mat &out, int rule = 0) const;
+
+        /// \brief Compute the attribute profile (and the differential profile) of the
+        /// image for a set of thresholds on an `Attribute` in a single traversal.
+        template<class TAT>
+        void attributeProfile(const std::vector <double> &thresholds, cv::Mat &profile, int rule = 0, cv::Mat *differential = NULL) const;
+
         /// \brief Assign the values of an `Attribute` as the level to each `Node`.
         template<class TAT>
         void assignAttributeAsLevel(Node *_root = NULL);
@@ -222,6 +304,11 @@ class ImageTree {
         template<class AT> // where AT is increasing Attribute
         void ultimateOpening(cv::Mat &residual, cv::Mat &scale) const;
 
+        /// \brief Calculate the extinction values of all the `Node`s (or only the leaves) for
+        /// an increasing `Attribute` in linear time.
+        template<class TAT> // where TAT is increasing TypedAttribute
+        void getExtinctions(std::vector <std::pair <double, fl::Node *> > &nodeExt, bool leavesOnly = false) const;
+
 #if 3
         /// \brief Assign a `PatternSpectra2D` based on two specific `Attribute`s
         /// to this `ImageTree`.
@@ -233,22 +320,53 @@ class ImageTree {
         template<class AT1, class AT2>
         void deletePatternSpectra2DFromTree() const;
 
+        /// \brief Calculate the global `PatternSpectra2D` of the `ImageTree` in a single
+        /// pass over the `Node`s, without assigning spectra to the `Node`s.
+        /// Defined in `treepatternspectra.h`.
+        template<class AT1, class AT2>
+        void globalPatternSpectra2D(const PatternSpectra2DSettings &settings, std::vector <double> &ps, bool parallel = true) const;
+
+        /// \brief Calculate the local pattern spectra (area and a shape `Attribute`) of a set
+        /// of image windows, all from this `ImageTree`. Defined in `treepatternspectra.h`.
+        template<class AT>
+        void localPatternSpectra2D(const std::vector <cv::Rect> &windows, const PatternSpectra2DSettings &settings,
+                                   std::vector <std::vector <double> > &spectra) const;
+
+        /// \brief Calculate the global pattern spectrum of the `ImageTree` over any number
+        /// of `Attribute`s. Defined in `treepatternspectra.h`.
+        template<class... ATs>
+        void patternSpectrumND(const std::vector <Binning> &binnings, PatternSpectrumND &ps, bool areaNormalize = false) const;
+
 #endif // 3
 
 #endif // 1
 
+        friend class TreeReconstruction;
+        friend class LevelAncestors;
+        friend class HorizontalCuts;
+        friend class ScaleSets;
+
         friend void markMserInTree(const ImageTree &tree, int deltaLvl, std::vector <Node *> &mser, std::vector <std::pair <double, int> > &div,
             int maxArea, int minArea, double maxVariation, double minDiversity);
 
 
     private:
         bool LCAPreprocessed;
-        std::vector <int> rootDistTour;
-        std::vector <double> levelTour;
+        std::vector <const Node *> nodeTour;
+        std::unordered_map <const Node *, int> tourPositions;
         cv::Mat *representatives;
-        detail::RMQPlusMinusOne<int> *rmq;
+        detail::CompactRMQPlusMinusOne *rmq;
+
+        void eulersTour(std::vector <int> &depthTour);
+        void checkLCAPreprocessed() const;
+
+        void topDownOrder(std::vector <fl::Node *> &order, std::vector <int> &parentIdx) const;
+        void calculateAllAttributes() const;
+        void labelRegions(const std::vector <fl::Node *> &order, const std::vector <int> &region, cv::Mat &labels) const;
 
-        void eulersTour(const Node *current, int depth = 0);
+        template<class T, class Function>
+        void renderFiltered(const std::vector <fl::Node *> &order, const std::vector <int> &parentIdx,
+                            const std::vector <T> &values, Function predicate, int rule, cv::Mat &out) const;
 
 #if 1
 
@@ -261,17 +379,11 @@ class ImageTree {
         template<class AT> // where AT is Attribute
         bool changeAttributeSettingsOfNode(Node *cur, AttributeSettings *nsettings) const;
 
-        template<class AT>
-        void calculateUO(std::vector <int> &residualMap,
-                         std::vector <int> &scaleMap,
-                         const std::pair <fl::Node *, int> &current,
-                         const fl::Node * ancestor,
-                         int parent) const;
+        template<class ATT>
+        void granulometryColumns(const fl::Node *root, int rule, std::vector <double> &values, std::vector <long long> &weights) const;
 
-        void reconstructUO(const std::vector< int > &res,
-                           const std::vector<int> &scl,
-                           cv::Mat &residual, cv::Mat &scale,
-                           std::pair<fl::Node *, int> &current) const;
+        template<class TAT> // where TAT is increasing TypedAttribute
+        void extinctionBranches(std::vector <fl::Node *> &order, std::vector <int> &parentIdx, std::vector <int> &branchHead) const;
 
 #if 3
         template<class AT1, class AT2>
@@ -284,6 +396,12 @@ class ImageTree {
         fl::Node *_root;
         int width, height;
 
+        /// \brief The `Node` holding each pixel as own element.
+        detail::PixelNodeMap *pixelMap;
+
+        /// \brief Assign the preorder ranges to the `Node`s and build the `pixelMap`.
+        void indexPixels();
+
         /// \brief Calls the destructor for a `Node` in the tree and the
         /// whole sub-hierarchy.
         void deallocateRoot(const Node *n);
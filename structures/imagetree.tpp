@@ -7,14 +7,81 @@
 #include "imagetree.h"
 
 #include "areaattribute.h"
+#include "frozentree.h"
+
+#include "../misc/parallel.h"
+#include "treereconstruction.h"
 
 #include <set>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
 
 #define markedSelf first
 #define markedBranch second
 
 namespace fl{
 
+namespace detail{
+
+/// Makes sure \p out is a \p rows x \p cols image with \p channels channels, of depth
+/// `CV_8U`, `CV_16U` or `CV_32S`. An image which already satisfies this is kept, otherwise
+/// it is allocated with the smallest depth holding the values in [\p minValue, \p maxValue].
+///
+/// \return The depth of \p out.
+inline int ensureProfileMat(cv::Mat &out, int rows, int cols, int channels, int minValue, int maxValue){
+    int depth = out.depth();
+    if (out.rows == rows && out.cols == cols && out.channels() == channels &&
+        (depth == CV_8U || depth == CV_16U || depth == CV_32S))
+        return depth;
+
+    if (minValue >= 0 && maxValue <= 255)
+        depth = CV_8U;
+    else if (minValue >= 0 && maxValue <= 65535)
+        depth = CV_16U;
+    else
+        depth = CV_32S;
+    out.create(rows, cols, CV_MAKETYPE(depth, channels));
+    return depth;
+}
+
+/// Writes the \p channels \p values into the pixel (\p x, \p y) of \p out, of depth
+/// \p depth (cf. `ensureProfileMat()`).
+inline void writeProfilePixel(cv::Mat &out, int depth, int x, int y, const int *values, int channels){
+    if (depth == CV_8U){
+        uchar *px = out.ptr<uchar>(y) + x * channels;
+        for (int j=0; j < channels; ++j)
+            px[j] = cv::saturate_cast<uchar>(values[j]);
+    }
+    else if (depth == CV_16U){
+        unsigned short *px = out.ptr<unsigned short>(y) + x * channels;
+        for (int j=0; j < channels; ++j)
+            px[j] = cv::saturate_cast<unsigned short>(values[j]);
+    }
+    else{
+        int *px = out.ptr<int>(y) + x * channels;
+        for (int j=0; j < channels; ++j)
+            px[j] = values[j];
+    }
+}
+
+/// Sorts (value, content) pairs by value and sums the contents of equal values.
+inline void sortAndReduce(std::vector <std::pair <double, long long> > &pairs){
+    if (pairs.empty())
+        return;
+    std::sort(pairs.begin(), pairs.end());
+    int last = 0;
+    for (int i=1, szi = pairs.size(); i < szi; ++i){
+        if (pairs[i].first == pairs[last].first)
+            pairs[last].second += pairs[i].second;
+        else
+            pairs[++last] = pairs[i];
+    }
+    pairs.resize(last + 1);
+}
+
+} // namespace detail
+
 /// Filters the tree by evaluating a `Predicate` on the level assigned
 /// to the `Node`, applying the selected filtering rule.
 /// Depending on the filtering rule, the gray level of certain `Node`s
@@ -92,6 +159,120 @@ void ImageTree::filterTreeByLevelPredicate(Function predicate, int rule, Node *r
     root->_propagatingHyperContrast.clear();
 }
 
+/// Produces the image obtained by reconstructing the `ImageTree` after a call to
+/// `filterTreeByLevelPredicate()` with the same \p predicate and \p rule (up to
+/// the differences noted in `renderFiltered()`), but leaves the `ImageTree`
+/// unchanged, so that it can be filtered again with different parameters.
+///
+/// \param predicate The functor object which operates on the `Node`s.
+/// \note cf. the class `Predicate` to see the correct form of this
+/// functor.
+///
+/// \param out Output, the filtered image. If it already has the size of the image
+/// and is of type `CV_8U`, `CV_16U` or `CV_32S`, its type is kept. Otherwise it is
+/// allocated as the smallest of those types which holds all the output gray levels.
+///
+/// \param rule Filtering rule to be used (cf. `filterTreeByLevelPredicate()`).
+///
+/// \note cf. `renderFiltered()` for the details of the evaluation.
+template<class Function>
+void ImageTree::filteredImageByLevelPredicate(Function predicate, cv::Mat &out, int rule) const{
+    std::vector <fl::Node *> order;
+    std::vector <int> parentIdx;
+    this->topDownOrder(order, parentIdx);
+
+    std::vector <double> values(order.size());
+    for (int i=0, szi = order.size(); i < szi; ++i)
+        values[i] = order[i]->level();
+
+    this->renderFiltered(order, parentIdx, values, predicate, rule, out);
+}
+
+/// Evaluates the filtering in one top-down pass over the `Node`s, keeping for every
+/// `Node` the index of its closest surviving ancestor (itself, if it survives). As in
+/// the recursive filtering, the \p predicate of each `Node` is evaluated against the
+/// value of its closest surviving ancestor. The output gray level of each `Node` is then:
+///     - for a surviving `Node`, its gray level, increased (subtractive rules) by the
+///       contrast of all the removed `Node`s above it.
+///     - for a removed `Node`, the output gray level of its closest surviving ancestor.
+/// With the max rules, all the descendants of a removed `Node` are removed as well.
+///
+/// \note The soft rules are evaluated as their hard counterparts (deletion of a single
+/// child always succeeds in this evaluation). The collapse of a whole set of siblings
+/// which a partitioning hierarchy performs when a deletion is refused is not emulated,
+/// and neither are the hyper gray levels.
+///
+/// \param order The `Node`s of the tree in top-down order (cf. `topDownOrder()`).
+/// \param parentIdx The index of the parent of each `Node` in \p order.
+/// \param values The value given to the \p predicate for each `Node` in \p order.
+/// \param predicate The functor object which operates on the \p values.
+/// \param rule Filtering rule to be used.
+/// \param out Output, the filtered image.
+template<class T, class Function>
+void ImageTree::renderFiltered(const std::vector <fl::Node *> &order, const std::vector <int> &parentIdx,
+                               const std::vector <T> &values, Function predicate, int rule, cv::Mat &out) const{
+    if (rule < 0 || rule > 5){
+        std::cerr << "Unknown filtering rule " << rule << "." << std::endl;
+        std::exit(-2);
+    }
+    int baseRule = rule % 3;
+
+    int szn = order.size();
+    std::vector <int> kept(szn);
+    std::vector <int> contrast(szn, 0);
+    std::vector <int> gray(szn);
+
+    kept[0] = 0;
+    gray[0] = order[0]->_grayLevel;
+    int minGray = gray[0], maxGray = gray[0];
+
+    for (int i=1; i < szn; ++i){
+        int p = parentIdx[i];
+        int anc = kept[p];
+
+        // a removed parent adds the contrast of its own edge
+        if (baseRule == 1 && anc != p)
+            contrast[i] = contrast[p] + order[parentIdx[p]]->_grayLevel - order[p]->_grayLevel;
+        else
+            contrast[i] = contrast[p];
+
+        if ((baseRule == 2 && anc != p) || predicate(values[i], values[anc]) == false){
+            kept[i] = anc;
+            gray[i] = gray[anc];
+        }
+        else{
+            kept[i] = i;
+            gray[i] = order[i]->_grayLevel + contrast[i];
+            minGray = std::min(minGray, gray[i]);
+            maxGray = std::max(maxGray, gray[i]);
+        }
+    }
+
+    int type = out.type();
+    if (out.rows != this->height || out.cols != this->width ||
+        (type != CV_8U && type != CV_16U && type != CV_32S)){
+        if (minGray >= 0 && maxGray <= 255)
+            type = CV_8U;
+        else if (minGray >= 0 && maxGray <= 65535)
+            type = CV_16U;
+        else
+            type = CV_32S;
+        out.create(this->height, this->width, type);
+    }
+
+    for (int i=0; i < szn; ++i){
+        const std::vector <std::pair <int, int> > &S = order[i]->_S;
+        for (int j=0, szj = S.size(); j < szj; ++j){
+            if (type == CV_8U)
+                out.at<uchar>(S[j].second, S[j].first) = cv::saturate_cast<uchar>(gray[i]);
+            else if (type == CV_16U)
+                out.at<unsigned short>(S[j].second, S[j].first) = cv::saturate_cast<unsigned short>(gray[i]);
+            else
+                out.at<int>(S[j].second, S[j].first) = gray[i];
+        }
+    }
+}
+
 #if 1
 
 /// Assigns a specific `TypedAttribute` to all the `Node`s in this `ImageTree`.
@@ -209,59 +390,139 @@ void ImageTree::analyseBranch(const fl::Node *node, std::vector <std::pair<int,
 /// rule = 1 -> difference with parent * number of pixels
 
 /// rule = 1 -> number of pixels  : OLD RULE, DEPRECATED, REFACTORING
+///
+/// \note Kept for compatibility, the values are computed by the exact mode of
+/// `calculateGranulometryHistogram()` and truncated to `int`.
 template<class ATT>
 void ImageTree::calculateGranulometryHistogram(std::map<double, int> &GCF, int rule, const fl::Node *_root) const{
-    if (_root == NULL){
-        this->calculateGranulometryHistogram<ATT>(GCF, rule, this->root());
-        return;
-    }
+    std::vector <std::pair <double, long long> > exact;
+    this->calculateGranulometryHistogram<ATT>(exact, rule, _root);
 
     GCF.clear();
+    for (int i=0, szi = exact.size(); i < szi; ++i)
+        GCF.insert(GCF.end(), std::make_pair(exact[i].first, (int)exact[i].second));
+}
 
-    if (rule > 0)
-        this->addAttributeToTree<fl::AreaAttribute>(new fl::AreaSettings());
+/// Exact-value mode: the granulometric curve is returned as a list of distinct values
+/// of \p ATT, in increasing order, each with the accumulated content of the regions with
+/// that value. The (value, content) pairs are sorted and reduced in parallel blocks,
+/// which are merged at the end.
+///
+/// \tparam ATT The `TypedAttribute` used as the size of the regions. Must be assigned
+/// to the tree with `addAttributeToTree` beforehand.
+///
+/// \param GCF Output, pairs of attribute value and content.
+/// \param rule The content measure:
+///     - 0 = number of regions.
+///     - 1 = volume, i.e. the area times the contrast with the parent (the root is omitted).
+/// \param _root (optional) The root of the subtree to process, the root of the tree if omitted.
+template<class ATT>
+void ImageTree::calculateGranulometryHistogram(std::vector <std::pair <double, long long> > &GCF, int rule, const fl::Node *_root) const{
+    std::vector <double> values;
+    std::vector <long long> weights;
+    this->granulometryColumns<ATT>((_root == NULL) ? this->_root : _root, rule, values, weights);
+
+    int szn = values.size();
+    int blocks = std::max(1, std::min(cv::getNumThreads() * 4, szn / 4096));
+    std::vector <std::vector <std::pair <double, long long> > > partial(blocks);
+
+    detail::parallelFor(blocks, [&](int begin, int end){
+        for (int b = begin; b < end; ++b){
+            int from = (long long)szn * b / blocks, to = (long long)szn * (b+1) / blocks;
+            std::vector <std::pair <double, long long> > &part = partial[b];
+            part.reserve(to - from);
+            for (int i = from; i < to; ++i)
+                part.emplace_back(values[i], weights[i]);
+            detail::sortAndReduce(part);
+        }
+    }, 1);
 
-    std::vector <const fl::Node *> toProcess(1, _root);
+    GCF.clear();
+    for (int b=0; b < blocks; ++b)
+        GCF.insert(GCF.end(), partial[b].begin(), partial[b].end());
+    detail::sortAndReduce(GCF);
+}
 
-    const Node *cur;
-    do{
-        cur = toProcess.back();
-
-        double attributeValue = (double)((ATT*)cur->getAttribute(ATT::name))->value();
-
-        // insert attributeValue in GCF
-        switch (rule){
-            case 0: // number of regions -> sum 1 for every region
-                ++GCF[attributeValue]; // ok, since if value does not exist, it will be initialized to 0
-                break;
-            // "area" not a real content metric; it's a difference metric
-            //case 1: // number of pixels -> sum the area of the region
-                // ok, since if value does not exist, it will be initialized to 0
-                // this might not work as a measure at all
-                // double parentValue = (double)((ATT*)(cur->parent())->getAttribute(ATT::name))->value();
-                //GCF[attributeValue] += ((fl::AreaAttribute *)cur->getAttribute(fl::AreaAttribute::name))->value();
-                //break;
-            //case 2:
-            case 1:
-            default:
-                if (! cur->isRoot()){
-                    int nodeLvl = cur->grayLevel();
-                    int parentLvl = cur->parent()->grayLevel();
-                    GCF[attributeValue] += ((fl::AreaAttribute *)cur->getAttribute(fl::AreaAttribute::name))->value()*std::abs(nodeLvl-parentLvl);
-                }
+/// Binned mode: the granulometric curve is accumulated into a flat array of bins. A
+/// region of value `v` is accumulated into the first bin `i` with `v <= binLimits[i]`,
+/// or into the last (overflow) bin if `v` is larger than all the limits. The regions are
+/// processed in parallel blocks, each with its own histogram, merged at the end.
+///
+/// \tparam ATT The `TypedAttribute` used as the size of the regions. Must be assigned
+/// to the tree with `addAttributeToTree` beforehand.
+///
+/// \param binLimits The upper limits of the bins, in increasing order.
+/// \param GCF Output, the content of each bin (`binLimits.size()+1` bins).
+/// \param rule The content measure (cf. the exact-value mode).
+/// \param _root (optional) The root of the subtree to process, the root of the tree if omitted.
+template<class ATT>
+void ImageTree::calculateGranulometryHistogram(const std::vector <double> &binLimits, std::vector <long long> &GCF, int rule, const fl::Node *_root) const{
+    std::vector <double> values;
+    std::vector <long long> weights;
+    this->granulometryColumns<ATT>((_root == NULL) ? this->_root : _root, rule, values, weights);
+
+    int szn = values.size();
+    int szb = binLimits.size() + 1;
+    int blocks = std::max(1, std::min(cv::getNumThreads() * 4, szn / 4096));
+    std::vector <long long> partial((size_t)blocks * szb, 0);
+
+    detail::parallelFor(blocks, [&](int begin, int end){
+        for (int b = begin; b < end; ++b){
+            long long *hist = &partial[(size_t)b * szb];
+            for (int i = (long long)szn * b / blocks, to = (long long)szn * (b+1) / blocks; i < to; ++i)
+                hist[std::lower_bound(binLimits.begin(), binLimits.end(), values[i]) - binLimits.begin()] += weights[i];
         }
+    }, 1);
 
-        toProcess.pop_back();
+    GCF.assign(szb, 0);
+    for (int b=0; b < blocks; ++b)
+        for (int j=0; j < szb; ++j)
+            GCF[j] += partial[(size_t)b * szb + j];
+}
 
-        for (int i=0, szi = cur->_children.size(); i < szi; ++i)
-            toProcess.push_back(cur->_children[i]);
-    }while(!toProcess.empty());
+/// Flattens the subtree of \p root into the columns used by the granulometries: the
+/// value of \p ATT and the content of every region. The areas needed for the volume are
+/// accumulated in a bottom-up pass over the flat array, without an `AreaAttribute`.
+///
+/// \param root The root of the subtree to process.
+/// \param rule The content measure (cf. `calculateGranulometryHistogram()`).
+/// \param values Output, the value of \p ATT of every region.
+/// \param weights Output, the content of every region.
+template<class ATT>
+void ImageTree::granulometryColumns(const fl::Node *root, int rule, std::vector <double> &values, std::vector <long long> &weights) const{
+    std::vector <const fl::Node *> order(1, root);
+    std::vector <int> parentIdx(1, -1);
+    for (int i=0; i < (int)order.size(); ++i){
+        const std::vector <fl::Node *> &chi = order[i]->_children;
+        for (int j=0, szj = chi.size(); j < szj; ++j){
+            order.push_back(chi[j]);
+            parentIdx.push_back(i);
+        }
+    }
+    int szn = order.size();
 
-    if (rule > 0)
-        this->deleteAttributeFromTree<fl::AreaAttribute>();
+    // attribute values are read sequentially, since they might be calculated on first access
+    values.resize(szn);
+    for (int i=0; i < szn; ++i)
+        values[i] = (double)((ATT*)order[i]->getAttribute(ATT::name))->value();
 
-    //std::partial_sum(GCF.begin(), GCF.end(), GCF.begin(),
-    //                 [](const std::pair<double, int>& x, const std::pair<double, int>& y){return std::make_pair(y.first, x.second + y.second);});
+    if (rule == 0){
+        weights.assign(szn, 1);
+        return;
+    }
+
+    std::vector <long long> area(szn, 0);
+    for (int i = szn-1; i > 0; --i){
+        area[i] += order[i]->_S.size();
+        area[parentIdx[i]] += area[i];
+    }
+    weights.resize(szn);
+    for (int i=1; i < szn; ++i)
+        weights[i] = area[i] * std::abs(order[i]->_grayLevel - order[parentIdx[i]]->_grayLevel);
+
+    // the root has no parent, and is not part of the volume curve
+    values.erase(values.begin());
+    weights.erase(weights.begin());
 }
 
 /// \param nodes A vector of nodes for which the output is written
@@ -499,6 +760,157 @@ void ImageTree::filterTreeByAttributePredicate(Function predicate, int rule, Nod
     root->_propagatingHyperContrast.clear();
 }
 
+/// Produces the image obtained by reconstructing the `ImageTree` after a call to
+/// `filterTreeByAttributePredicate()` with the same \p predicate and \p rule (up to
+/// the differences noted in `renderFiltered()`), but leaves the `ImageTree`
+/// unchanged, so that it can be filtered again with different parameters.
+///
+/// \tparam TAT Specifies the `TypedAttribute` whose values are used in the evaluation
+/// of the \p predicate. Must be assigned to the tree with `addAttributeToTree` beforehand.
+///
+/// \param predicate The functor object which operates on the `Attribute` values.
+/// \param out Output, the filtered image (cf. `filteredImageByLevelPredicate()`).
+/// \param rule Filtering rule to be used (cf. `filterTreeByAttributePredicate()`).
+template<class TAT, class Function>
+void ImageTree::filteredImageByAttributePredicate(Function predicate, cv::Mat &out, int rule) const{
+    std::vector <fl::Node *> order;
+    std::vector <int> parentIdx;
+    this->topDownOrder(order, parentIdx);
+
+    std::vector <typename TAT::attribute_type> values;
+    values.reserve(order.size());
+    for (int i=0, szi = order.size(); i < szi; ++i)
+        values.push_back(((TAT*)order[i]->getAttribute(TAT::name))->value());
+
+    this->renderFiltered(order, parentIdx, values, predicate, rule, out);
+}
+
+/// Computes the attribute profile of the image, i.e. the stack of images obtained by
+/// filtering the `ImageTree` with `GreaterThanX(t)` on the values of \p TAT for every
+/// threshold `t` in \p thresholds, without modifying the tree. Channel `j` of \p profile
+/// holds the image filtered with `thresholds[j]`, and is equal to the output of
+/// `filteredImageByAttributePredicate<TAT>()` with the same predicate and \p rule.
+///
+/// Since the thresholds are sorted, the set of thresholds for which a `Node` passes the
+/// predicate is a prefix of \p thresholds, found with a single binary search. All the
+/// filtered images are then obtained in one top-down pass, where the gray levels of a
+/// `Node` for the thresholds it fails are taken over from its parent. For an increasing
+/// \p TAT the sets of kept `Node`s are nested and all the filtering rules coincide.
+///
+/// \tparam TAT Specifies the `TypedAttribute` used for the profile (e.g. `AreaAttribute`).
+/// Must be assigned to the tree with `addAttributeToTree` beforehand.
+///
+/// \param thresholds The thresholds on the values of \p TAT, in increasing order.
+///
+/// \param profile Output, a multichannel image with one channel per threshold. If it
+/// is preallocated with the size of the image, `thresholds.size()` channels and a depth
+/// of `CV_8U`, `CV_16U` or `CV_32S`, it is written into directly. Otherwise it is
+/// allocated with the smallest of those depths which holds all the values.
+///
+/// \param rule Filtering rule to be used (cf. `filterTreeByAttributePredicate()`). Soft
+/// rules are evaluated as their hard counterparts.
+///
+/// \param differential (optional) Output, the differential profile. Channel `j` holds
+/// the absolute difference between the images filtered with `thresholds[j-1]` and
+/// `thresholds[j]`, where channel 0 is compared to the unfiltered image. Allocated in
+/// the same way as \p profile.
+template<class TAT>
+void ImageTree::attributeProfile(const std::vector <double> &thresholds, cv::Mat &profile, int rule, cv::Mat *differential) const{
+    if (rule < 0 || rule > 5){
+        std::cerr << "Unknown filtering rule " << rule << "." << std::endl;
+        std::exit(-2);
+    }
+    int k = thresholds.size();
+    if (k == 0){
+        std::cerr << "Attribute profile requires at least one threshold." << std::endl;
+        std::exit(-2);
+    }
+    for (int j=1; j < k; ++j){
+        if (thresholds[j] < thresholds[j-1]){
+            std::cerr << "Attribute profile thresholds need to be sorted in increasing order." << std::endl;
+            std::exit(-2);
+        }
+    }
+    int baseRule = rule % 3;
+
+    std::vector <fl::Node *> order;
+    std::vector <int> parentIdx;
+    this->topDownOrder(order, parentIdx);
+    int szn = order.size();
+
+    // passed[i]: number of (leading) thresholds for which the i-th Node is kept
+    std::vector <int> passed(szn);
+    // per Node and threshold: output gray level, and (subtractive) accumulated contrast
+    std::vector <int> gray((size_t)szn * k);
+    std::vector <int> contrast;
+    if (baseRule == 1)
+        contrast.assign((size_t)szn * k, 0);
+
+    int minValue = order[0]->_grayLevel, maxValue = minValue;
+    for (int i=0; i < szn; ++i){
+        const fl::Node *cur = order[i];
+        double value = (double)((TAT*)cur->getAttribute(TAT::name))->value();
+        int p = parentIdx[i];
+
+        if (p < 0)
+            passed[i] = k; // the root is never filtered
+        else{
+            passed[i] = std::lower_bound(thresholds.begin(), thresholds.end(), value) - thresholds.begin();
+            if (baseRule == 2)
+                passed[i] = std::min(passed[i], passed[p]);
+        }
+
+        int *row = &gray[(size_t)i * k];
+        const int *prow = (p < 0) ? NULL : &gray[(size_t)p * k];
+        if (baseRule == 1){
+            int *crow = &contrast[(size_t)i * k];
+            if (p >= 0){
+                // a removed parent adds the contrast of its own edge
+                const int *pcrow = &contrast[(size_t)p * k];
+                int edge = (passed[p] < k) ? order[parentIdx[p]]->_grayLevel - order[p]->_grayLevel : 0;
+                for (int j=0; j < k; ++j)
+                    crow[j] = pcrow[j] + ((j < passed[p]) ? 0 : edge);
+            }
+            for (int j=0; j < passed[i]; ++j)
+                row[j] = cur->_grayLevel + crow[j];
+        }
+        else{
+            for (int j=0; j < passed[i]; ++j)
+                row[j] = cur->_grayLevel;
+        }
+        for (int j=passed[i]; j < k; ++j)
+            row[j] = prow[j];
+
+        minValue = std::min(minValue, cur->_grayLevel);
+        maxValue = std::max(maxValue, cur->_grayLevel);
+        for (int j=0; j < passed[i]; ++j){
+            minValue = std::min(minValue, row[j]);
+            maxValue = std::max(maxValue, row[j]);
+        }
+    }
+
+    int depth = detail::ensureProfileMat(profile, this->height, this->width, k, minValue, maxValue);
+    int diffDepth = -1;
+    if (differential != NULL)
+        diffDepth = detail::ensureProfileMat(*differential, this->height, this->width, k, 0, maxValue - minValue);
+
+    std::vector <int> diff(k);
+    for (int i=0; i < szn; ++i){
+        const std::vector <std::pair <int, int> > &S = order[i]->_S;
+        const int *row = &gray[(size_t)i * k];
+        if (differential != NULL){
+            diff[0] = std::abs(order[i]->_grayLevel - row[0]);
+            for (int j=1; j < k; ++j)
+                diff[j] = std::abs(row[j-1] - row[j]);
+        }
+        for (int j=0, szj = S.size(); j < szj; ++j){
+            detail::writeProfilePixel(profile, depth, S[j].first, S[j].second, row, k);
+            if (differential != NULL)
+                detail::writeProfilePixel(*differential, diffDepth, S[j].first, S[j].second, &diff[0], k);
+        }
+    }
+}
+
 /// \tparam TAT Specifies the `TypedAttribute<X>` whose values are used as
 /// new levels in this `ImageTree` (e.g. `AreaAttribute`).
 ///
@@ -535,20 +947,128 @@ void ImageTree::assignAttributeAsLevel(Node *root){
 /// \tparam AT Specifies the `TypedAttribute` to be used for the base attribute opening.
 /// Must be increasing. Must be assigned to the image with `addAttributeToTree` beforehand.
 ///
-/// \param residual Output parameter for the residual component of the ultimate opening.
-/// \param scale Output parameter for the scale component of the ultimate opening.
+/// The residues and scales are propagated in a single top-down pass over a flat
+/// ordering of the `Node`s (no recursion, so deep trees are supported), the areas
+/// are accumulated bottom-up in the same arrays, and both images are filled in
+/// parallel through `TreeReconstruction`.
+///
+/// \param residual Output parameter for the residual component of the ultimate opening
+/// (`CV_16U`, which holds the residues of 16-bit images).
+/// \param scale Output parameter for the scale component of the ultimate opening
+/// (`CV_16U`, or `CV_32S` if the values of \p AT do not fit).
 ///
 template<class AT> // where AT is increasing Attribute
 void ImageTree::ultimateOpening(cv::Mat &residual, cv::Mat &scale) const{
     // assuming AT is in tree
-    std::vector <int> res;
-    std::vector <int> scl;
-    std::pair<fl::Node *, int> start(this->_root, 0);
+    TreeReconstruction reconstruction(*this);
+    const std::vector <fl::Node *> &order = reconstruction.nodes();
+    const std::vector <int> &parentIdx = reconstruction.parents();
+    int szn = order.size();
+
+    std::vector <double> attribute(szn);
+    for (int i=0; i < szn; ++i)
+        attribute[i] = (double)((AT*)order[i]->getAttribute(AT::name))->value();
+
+    std::vector <long long> area(szn, 0);
+    for (int i = szn-1; i >= 0; --i){
+        area[i] += order[i]->_S.size();
+        if (parentIdx[i] >= 0)
+            area[parentIdx[i]] += area[i];
+    }
+
+    // top-down: the ancestor the residue is measured against (parent of the highest Node
+    // with the same attribute value), and the residue and scale propagated from above
+    std::vector <int> anc(szn, -1);
+    std::vector <double> res(szn, 0), scl(szn, 0);
+    for (int i=1; i < szn; ++i){
+        int p = parentIdx[i];
+        anc[i] = (attribute[i] != attribute[p]) ? p : anc[p];
+
+        // no residue below the root without an ancestor of a different attribute value
+        int own = (anc[i] < 0) ? 0 : order[i]->_grayLevel - order[anc[i]]->_grayLevel;
+        if (res[p] > own){
+            res[i] = res[p];
+            scl[i] = scl[p];
+        }
+        else{
+            res[i] = own;
+            scl[i] = attribute[i] + 1;
+        }
+    }
+
+    // the residue of each Node is attenuated by its area relative to the ancestor
+    const double k = 205./100;
+    detail::parallelFor(szn, [&](int begin, int end){
+        for (int i = begin; i < end; ++i){
+            if (res[i] <= 0)
+                continue;
+            double ancArea = (anc[i] < 0) ? area[i] : area[anc[i]];
+            res[i] = std::max(0, (int)(res[i] - k * (1 - area[i] / ancArea)));
+            if (res[i] == 0)
+                scl[i] = 0;
+        }
+    }, 4096);
 
-    this->addAttributeToTree<fl::AreaAttribute>(new fl::AreaSettings());
-    this->calculateUO<AT>(res, scl, start, NULL, -1);
-    this->reconstructUO(res, scl, residual, scale, start);
-    this->deleteAttributeFromTree<fl::AreaAttribute>();
+    double maxScale = *std::max_element(scl.begin(), scl.end());
+    reconstruction.render(residual, res, 1, CV_16U);
+    reconstruction.render(scale, scl, 1, (maxScale <= 65535) ? CV_16U : CV_32S);
+}
+
+/// Based on Vachier, C., Meyer, F.: "Extinction value: a new measurement of
+/// persistence" (1995) and Silva, A.G, Alencar Lotufo, R.: "New extinction values
+/// from efficient construction and analysis of extended attribute component
+/// tree" (2008)
+///
+/// The extinction value of a `Node` is the value of the `Attribute` \p TAT of
+/// the largest region of its branch, i.e. of the highest ancestor reached by
+/// repeatedly moving to the parent while the current `Node` is the child with
+/// the largest value of \p TAT among its siblings. The extinction value of a
+/// leaf corresponds to the classical extinction value of the regional extremum.
+///
+/// The values are obtained in a single top-down pass over the `ImageTree` in
+/// O(n), and no state of the `Node`s is modified.
+///
+/// \tparam TAT The `TypedAttribute` used to calculate the extinction values (e.g.
+/// `AreaAttribute`, `RegionDynamicsAttribute`). Must be increasing, with a value
+/// convertible to `double`. Must be assigned to the tree with `addAttributeToTree`
+/// beforehand.
+///
+/// \param nodeExt Output, pairs of extinction value and `Node`, for all the `Node`s
+/// of the tree in top-down order (parents before children).
+/// \param leavesOnly If set to `true`, only the leaf `Node`s are output.
+template<class TAT> // where TAT is increasing TypedAttribute
+void ImageTree::getExtinctions(std::vector <std::pair <double, fl::Node *> > &nodeExt, bool leavesOnly) const{
+    nodeExt.clear();
+    std::vector <fl::Node *> order;
+    std::vector <int> parentIdx, branchHead;
+    this->extinctionBranches<TAT>(order, parentIdx, branchHead);
+
+    for (int i=0, szi = order.size(); i < szi; ++i){
+        if (leavesOnly && !order[i]->_children.empty())
+            continue;
+        const fl::Node *head = order[branchHead[i]];
+        nodeExt.emplace_back((double)((TAT *)head->getAttribute(TAT::name))->value(), order[i]);
+    }
+}
+
+/// Calculates the values of all the `Attribute`s assigned to the tree which were
+/// not calculated yet, and builds a `FrozenTree`, which holds all the other lazily
+/// computed values and copies of the values of the `Attribute`s \p TATs in immutable
+/// arrays. All the queries of the returned handle are thread-safe.
+///
+/// \tparam TATs The `TypedAttribute`s to copy, readable with `FrozenTree::attribute()`.
+/// Must be assigned to the tree with `addAttributeToTree` beforehand.
+///
+/// \note The `ImageTree` must not be modified while the handle is in use.
+///
+/// \return The immutable handle.
+template<class... TATs>
+std::shared_ptr <const FrozenTree> ImageTree::freeze() const{
+    this->calculateAllAttributes();
+    std::shared_ptr <FrozenTree> frozen = std::make_shared <FrozenTree>(*this);
+    int copied[] = {0, (frozen->copyAttribute<TATs>(), 0)...};
+    (void)copied;
+    return frozen;
 }
 
 #if 3
@@ -679,65 +1199,36 @@ bool ImageTree::changeAttributeSettingsOfNode(Node *cur, AttributeSettings *nset
 
 
 
-/// \note Still didn't undergo rigorous testing.
-template<class AT>
-void ImageTree::calculateUO(std::vector <int> &residualMap,
-                            std::vector <int> &scaleMap,
-                            const std::pair <fl::Node *, int> &current,
-                            const fl::Node * ancestor, // the one with maximum contrast
-                            int parent) const{ // first parent
-
-    int selfAttribute = ((AT*)current.first->getAttribute(AT::name))->value();
-    int selfArea = ((fl::AreaAttribute*)current.first->getAttribute(fl::AreaAttribute::name))->value();
-    int selfGlevel = current.first->grayLevel();
-
-    //std::cout << selfAttribute << " " << selfArea << " " << selfGlevel << std::endl;
-
-    int ancArea = selfArea;
-
-    if (ancestor != NULL){
-        int ancGlevel = ancestor->grayLevel();
-        ancArea = ((fl::AreaAttribute*)ancestor->getAttribute(fl::AreaAttribute::name))->value();
-        residualMap.emplace_back(selfGlevel - ancGlevel);
-    }
-    else{
-        residualMap.emplace_back(0);
-    }
-
-    if (parent == -1){
-        scaleMap.emplace_back(0);
-    }
-    else if (residualMap[parent] > residualMap[current.second]){
-        residualMap[current.second] = residualMap[parent];
-        scaleMap.emplace_back(scaleMap[parent]);
-    }
-    else{
-        scaleMap.emplace_back(selfAttribute+1);
-    }
-
-    for (int i=0, szi = current.first->_children.size(); i < szi; ++i){
-        int childAttribute = ((AT*)current.first->_children[i]->getAttribute(AT::name))->value();
-        if (childAttribute != selfAttribute){
-            this->calculateUO<AT>(residualMap, scaleMap, std::make_pair(current.first->_children[i], (int)residualMap.size()), current.first, current.second);
+/// Orders the `Node`s of the tree top-down (breadth-first) and assigns each of them
+/// to a branch: a child with the largest value of \p TAT among its siblings continues
+/// the branch of its parent, while every other child starts its own branch.
+///
+/// \param order Output, the `Node`s of the tree in top-down order.
+/// \param parentIdx Output, the index of the parent of each `Node` in \p order (-1 for the root).
+/// \param branchHead Output, the index of the highest `Node` of the branch of each `Node` in \p order.
+template<class TAT> // where TAT is increasing TypedAttribute
+void ImageTree::extinctionBranches(std::vector <fl::Node *> &order, std::vector <int> &parentIdx, std::vector <int> &branchHead) const{
+    order.assign(1, this->_root);
+    parentIdx.assign(1, -1);
+    branchHead.assign(1, 0);
+
+    for (int i=0; i < (int)order.size(); ++i){
+        const fl::Node *cur = order[i];
+        int best = -1;
+        double bestValue = 0;
+        for (int j=0, szj = cur->_children.size(); j < szj; ++j){
+            double value = (double)((TAT *)cur->_children[j]->getAttribute(TAT::name))->value();
+            if (best < 0 || value > bestValue){
+                best = j;
+                bestValue = value;
+            }
         }
-        else{
-            this->calculateUO<AT>(residualMap, scaleMap, std::make_pair(current.first->_children[i], (int)residualMap.size()), ancestor, current.second);
+        for (int j=0, szj = cur->_children.size(); j < szj; ++j){
+            order.push_back(cur->_children[j]);
+            parentIdx.push_back(i);
+            branchHead.push_back(j == best ? branchHead[i] : (int)order.size()-1);
         }
     }
-
-//    residualMap[current.second] *= (double)selfArea/ancArea;
-    double k = 205./100;
-    //double k = 10./7;
-    if (residualMap[current.second] > 0) {
-        //std::cout << "Recalculating residual with factor: " << selfArea << " " << ancArea << " values old/new: ";
-        //std::cout << residualMap[current.second] << " ";
-        //std::cout << "factor: " << k * (1 - (double)selfArea/ancArea) << " " << k << " " <<  (double)selfArea/ancArea;
-        residualMap[current.second] -= k * (1 - (double)selfArea/ancArea);
-        if (residualMap[current.second] < 0) residualMap[current.second] = 0;
-        if (residualMap[current.second] == 0)
-            scaleMap[current.second] = 0;
-        //std::cout << residualMap[current.second] << std::endl;
-    }
 }
 
 #if 3
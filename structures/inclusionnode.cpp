@@ -1,6 +1,7 @@
 #include "inclusionnode.h"
 
 #include <string>
+#include <mutex>
 
 using namespace fl;
 
@@ -8,6 +9,9 @@ int InclusionNode::counter = 0;
 
 std::map <double, InclusionNode *> InclusionNode::dummies = std::map<double, InclusionNode *>();
 
+/// Guards `InclusionNode::dummies`, so that trees can be built in parallel.
+static std::mutex dummiesLock;
+
 InclusionNode::InclusionNode(const InclusionNode &other) : Node(other), myNumber(other.myNumber), isDummy(other.isDummy){ }
 
 /// Constructor initializing internal `InclusionNode` elements (pixels).
@@ -47,11 +51,13 @@ InclusionNode::InclusionNode(const double &level)
 /// at a certain level.
 ///
 /// \remark A separate singleton is created for every different \p level requested.
+/// Thread-safe.
 ///
 /// \param level The level of the singleton `InclusionNode` requested.
 ///
 /// \return A reference to the singleton `InclusionNode` for the requested \p level.
 InclusionNode& InclusionNode::dummy(const double &level){
+    std::lock_guard <std::mutex> guard(dummiesLock);
     std::map<double, InclusionNode *>::iterator it;
     if ((it=InclusionNode::dummies.find(level)) == InclusionNode::dummies.end()){
         it = InclusionNode::dummies.insert(std::pair<double, InclusionNode *>(level, new InclusionNode(level))).first; // <- 3 hidden calls to copy constructor :/
@@ -75,6 +81,7 @@ void InclusionNode::assignLevel(const double &level){
     fl::Node::assignLevel(level);
 
     if (this->isDummy && level != old){
+        std::lock_guard <std::mutex> guard(dummiesLock);
         std::map<double, InclusionNode *>::iterator it = InclusionNode::dummies.find(old);
         InclusionNode::dummies.insert(std::make_pair(level, it->second));
         InclusionNode::dummies.erase(it);
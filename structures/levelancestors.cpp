@@ -0,0 +1,174 @@
+/// \file structures/levelancestors.cpp
+/// \author Petra Bosilj
+
+#include "levelancestors.h"
+
+#include "imagetree.h"
+#include "node.h"
+
+#include <algorithm>
+#include <cmath>
+
+/// The number of parent steps tried before binary lifting in `LevelAncestors::lowestCommonAncestor()`.
+#define LCA_WALK_STEPS 8
+
+/// Orders the `Node`s top-down, accumulates the areas bottom-up and the level
+/// variations top-down, and fills the table of jump pointers level by level.
+///
+/// \param tree The `ImageTree` to index.
+fl::LevelAncestors::LevelAncestors(const ImageTree &tree) : monotoneLevels(true){
+    tree.topDownOrder(this->order, this->parentIdx);
+    int szn = this->order.size();
+
+    this->depths.assign(szn, 0);
+    this->levels.resize(szn);
+    this->variation.assign(szn, 0.0);
+    this->areas.resize(szn);
+    int maxDepth = 0, direction = 0;
+    for (int i=0; i < szn; ++i){
+        this->positions[this->order[i]] = i;
+        this->levels[i] = this->order[i]->level();
+        this->areas[i] = this->order[i]->getOwnElements().size();
+        int p = this->parentIdx[i];
+        if (p < 0)
+            continue;
+        this->depths[i] = this->depths[p] + 1;
+        maxDepth = std::max(maxDepth, this->depths[i]);
+        this->variation[i] = this->variation[p] + std::abs(this->levels[i] - this->levels[p]);
+
+        int step = (this->levels[i] > this->levels[p]) - (this->levels[i] < this->levels[p]);
+        if (step != 0){
+            if (direction != 0 && step != direction)
+                this->monotoneLevels = false;
+            direction = step;
+        }
+    }
+    for (int i = szn-1; i > 0; --i)
+        this->areas[this->parentIdx[i]] += this->areas[i];
+
+    for (this->logDepth = 1; (1 << this->logDepth) <= maxDepth; ++this->logDepth);
+    this->jumps.resize((size_t)this->logDepth * szn);
+    std::copy(this->parentIdx.begin(), this->parentIdx.end(), this->jumps.begin());
+    for (int k=1; k < this->logDepth; ++k){
+        const int *prev = &this->jumps[(size_t)(k-1) * szn];
+        int *cur = &this->jumps[(size_t)k * szn];
+        for (int i=0; i < szn; ++i)
+            cur[i] = (prev[i] < 0) ? -1 : prev[prev[i]];
+    }
+}
+
+int fl::LevelAncestors::size() const { return this->order.size(); }
+
+fl::Node *fl::LevelAncestors::node(int i) const { return this->order[i]; }
+
+int fl::LevelAncestors::index(const Node *n) const{
+    std::unordered_map <const Node *, int>::const_iterator it = this->positions.find(n);
+    return (it == this->positions.end()) ? -1 : it->second;
+}
+
+int fl::LevelAncestors::parent(int i) const { return this->parentIdx[i]; }
+
+int fl::LevelAncestors::depth(int i) const { return this->depths[i]; }
+
+double fl::LevelAncestors::level(int i) const { return this->levels[i]; }
+
+int fl::LevelAncestors::elementCount(int i) const { return this->areas[i]; }
+
+/// Answered in O(log \p depth) using the jump pointers.
+///
+/// \return The index of the ancestor, -1 if \p depth is larger than the depth
+/// of the `Node`.
+int fl::LevelAncestors::ancestor(int i, int depth) const{
+    if (depth > this->depths[i])
+        return -1;
+    int szn = this->order.size();
+    for (int k=0; depth > 0; ++k, depth >>= 1)
+        if (depth & 1)
+            i = this->jumps[(size_t)k * szn + i];
+    return i;
+}
+
+/// \return The index of the closest ancestor with more than \p area pixels,
+/// -1 if there is none.
+int fl::LevelAncestors::firstAncestorAboveArea(int i, double area) const{
+    const std::vector <int> &areas = this->areas;
+    return this->parentIdx[this->highestAncestor(i, [&](int j){ return areas[j] <= area; })];
+}
+
+/// Uses binary lifting when the levels change monotonically along the branches
+/// (max-trees, min-trees, alpha-trees), and walks up the branch otherwise.
+///
+/// \return The index of the closest ancestor with the level outside of
+/// [`level(i)` - \p delta, `level(i)` + \p delta], -1 if there is none.
+int fl::LevelAncestors::firstAncestorBeyondLevel(int i, double delta) const{
+    const std::vector <double> &levels = this->levels;
+    double lvl = levels[i];
+
+    if (this->monotoneLevels)
+        return this->parentIdx[this->highestAncestor(i, [&](int j){ return std::abs(levels[j] - lvl) <= delta; })];
+
+    int j = this->parentIdx[i];
+    for (; j >= 0 && std::abs(levels[j] - lvl) <= delta; j = this->parentIdx[j]);
+    return j;
+}
+
+/// The cumulative level variation is the sum of the absolute level differences
+/// between the successive `Node`s on the branch, which always increases going up.
+///
+/// \return The index of the highest ancestor (or \p i itself) reached with a
+/// cumulative level variation of at most \p delta.
+int fl::LevelAncestors::highestAncestorByVariation(int i, double delta) const{
+    const std::vector <double> &variation = this->variation;
+    double limit = variation[i] - delta;
+    return this->highestAncestor(i, [&](int j){ return variation[j] >= limit; });
+}
+
+/// Finds the highest ancestor with the area no larger than \p perc times the
+/// area of the `Node`. If already the parent is larger, returns the parent when
+/// its area is smaller than 1.6 * \p perc times the area of the `Node`, and the
+/// `Node` itself otherwise.
+///
+/// \return The index of the appropriate ancestor, or \p i.
+int fl::LevelAncestors::parentBySize(int i, double perc) const{
+    const std::vector <int> &areas = this->areas;
+    double oriSize = areas[i];
+    int high = this->highestAncestor(i, [&](int j){ return ((double)areas[j]) / oriSize <= perc; });
+
+    int p = this->parentIdx[i];
+    if (high == i && p >= 0 && ((double)areas[p]) / oriSize < (1.6*perc))
+        return p;
+    return high;
+}
+
+/// `Node`s close in the tree (e.g. those holding two adjacent pixels) are first
+/// joined by following the parents for a few steps. The other cases are answered
+/// in O(log n) by binary lifting.
+///
+/// \param i The index of the first `Node`.
+/// \param j The index of the second `Node`.
+int fl::LevelAncestors::lowestCommonAncestor(int i, int j) const{
+    for (int step=0; step < LCA_WALK_STEPS && i != j; ++step){
+        if (this->depths[i] >= this->depths[j])
+            i = this->parentIdx[i];
+        else
+            j = this->parentIdx[j];
+    }
+    if (i == j)
+        return i;
+
+    if (this->depths[i] < this->depths[j])
+        std::swap(i, j);
+    i = this->ancestor(i, this->depths[i] - this->depths[j]);
+    if (i == j)
+        return i;
+
+    int szn = this->order.size();
+    for (int k = this->logDepth-1; k >= 0; --k){
+        int ai = this->jumps[(size_t)k * szn + i], aj = this->jumps[(size_t)k * szn + j];
+        if (ai != aj){
+            i = ai;
+            j = aj;
+        }
+    }
+    return this->parentIdx[i];
+}
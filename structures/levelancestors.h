@@ -0,0 +1,98 @@
+/// \file structures/levelancestors.h
+/// \author Petra Bosilj
+
+#ifndef LEVELANCESTORS_H
+#define LEVELANCESTORS_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+namespace fl{
+
+    class ImageTree;
+    class Node;
+
+    /// \class LevelAncestors
+    ///
+    /// \brief An index answering ancestor queries on an `ImageTree` in O(log n),
+    /// instead of following the parent pointers one step at a time.
+    ///
+    /// The `Node`s are stored in top-down order (the root has index 0) together
+    /// with a table of jump pointers: the ancestor 2^k steps above every `Node`.
+    /// The ancestor at a given depth, and the first ancestor for which some
+    /// monotone condition fails (e.g. the area exceeds a threshold), are found by
+    /// binary lifting over the table.
+    ///
+    /// \note Obtained with `ImageTree::levelAncestors()`. The `ImageTree` must not
+    /// be modified (e.g. filtered) while the index is in use.
+    class LevelAncestors{
+        public:
+            /// \brief Constructor, indexing \p tree.
+            LevelAncestors(const ImageTree &tree);
+
+            /// \brief The number of `Node`s in the tree.
+            int size() const;
+
+            /// \brief The `Node` at the index \p i.
+            Node *node(int i) const;
+
+            /// \brief The index of a `Node`, -1 if not in the tree.
+            int index(const Node *n) const;
+
+            /// \brief The index of the parent (-1 for the root).
+            int parent(int i) const;
+
+            /// \brief The distance from the root.
+            int depth(int i) const;
+
+            /// \brief The level of the `Node`.
+            double level(int i) const;
+
+            /// \brief The number of pixels of the `Node`.
+            int elementCount(int i) const;
+
+            /// \brief The index of the ancestor \p depth steps above.
+            int ancestor(int i, int depth) const;
+
+            /// \brief The highest ancestor reachable while \p predicate holds.
+            template <class Function>
+            int highestAncestor(int i, Function predicate) const;
+
+            /// \brief The first ancestor with the area larger than \p area.
+            int firstAncestorAboveArea(int i, double area) const;
+
+            /// \brief The first ancestor with the level differing from the level
+            /// of the `Node` by more than \p delta.
+            int firstAncestorBeyondLevel(int i, double delta) const;
+
+            /// \brief The highest ancestor reached from the `Node` by a cumulative
+            /// level variation of at most \p delta.
+            int highestAncestorByVariation(int i, double delta) const;
+
+            /// \brief The equivalent of `Node::parentBySize()`.
+            int parentBySize(int i, double perc) const;
+
+            /// \brief The index of the lowest common ancestor of two `Node`s.
+            int lowestCommonAncestor(int i, int j) const;
+
+        private:
+            std::vector <Node *> order;
+            std::unordered_map <const Node *, int> positions;
+            std::vector <int> parentIdx;
+            std::vector <int> depths;
+            std::vector <int> areas;
+            std::vector <double> levels;
+            std::vector <double> variation;
+            bool monotoneLevels;
+
+            /// \brief The jump pointers, `jumps[k*size() + i]` is the ancestor 2^k
+            /// steps above `Node` i (-1 if there is none).
+            std::vector <int> jumps;
+            int logDepth;
+    };
+}
+
+#include "levelancestors.tpp"
+
+#endif // LEVELANCESTORS_H
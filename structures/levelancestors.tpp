@@ -0,0 +1,34 @@
+/// \file structures/levelancestors.tpp
+/// \author Petra Bosilj
+
+#ifndef TPP_LEVELANCESTORS
+#define TPP_LEVELANCESTORS
+
+#include "levelancestors.h"
+
+namespace fl{
+
+/// Climbs from the `Node` \p i by binary lifting, only stepping onto ancestors
+/// for which \p predicate holds. The `Node` \p i itself is not tested.
+///
+/// \param i The index of the `Node`.
+/// \param predicate A function taking the index of an ancestor and returning
+/// `bool`. Needs to be monotone along the branch: once it fails for an ancestor,
+/// it needs to fail for all the ancestors above it.
+///
+/// \return The index of the highest ancestor for which \p predicate holds, \p i
+/// if it fails for the parent.
+template <class Function>
+int LevelAncestors::highestAncestor(int i, Function predicate) const{
+    int szn = this->order.size();
+    for (int k = this->logDepth-1; k >= 0; --k){
+        int j = this->jumps[(size_t)k * szn + i];
+        if (j >= 0 && predicate(j))
+            i = j;
+    }
+    return i;
+}
+
+}
+
+#endif // TPP_LEVELANCESTORS
@@ -1,10 +1,10 @@
-/// \file structures/rangeattribute.h
+/// \file structures/meanattribute.h
 /// \author Petra Bosilj
 
 #ifndef MEANATTRIBUTE_H
 #define MEANATTRIBUTE_H
 
-#include "attribute.h"
+#include "valuestatisticsattribute.h"
 
 namespace fl{
 /// \class MeanSettings
@@ -25,25 +25,26 @@ namespace fl{
 ///
 /// \brief Value of this `Attribute` is the mean gray level of the region.
 ///
+/// The value is obtained from the `ValueStatistics` of the region, shared with
+/// `ValueDeviationAttribute` and `RangeAttribute`.
 ///
 /// \note The calculation of this attribute requires reading the pixel values. The corresponding image has to be
 /// assigned with `ImageTree::setImage()`.
-    class MeanAttribute : public TypedAttribute<double>
+    class MeanAttribute : public ValueStatisticsAttribute
     {
         public:
             static const std::string name;
 
-            /// \brief The constructor for `RangeAttribute`.
+            /// \brief The constructor for `MeanAttribute`.
             MeanAttribute(const Node *baseNode, const ImageTree *baseTree, AttributeSettings *settings, int deleteSettings = false);
 
-            /// \brief The destructor for the `RangeAttribute`.
+            /// \brief The destructor for the `MeanAttribute`.
             virtual ~MeanAttribute();
 
-            /// \brief Triggers the calculation of the `RangeAttribute` for a `Node`.
+            /// \brief Triggers the calculation of the `MeanAttribute` for a `Node`.
             virtual void calculateAttribute();
         protected:
         private:
-            int N;
     };
 }
 
@@ -108,47 +108,98 @@ void fl::MomentsAttribute::calculateAttribute(){
     }
 
     const std::vector <pxCoord> &coords = this->myNode->getOwnElements();
-    int order = ((MomentsSettings *)(this->getSettings()))->order;
-    std::vector <long long> &myRawMoments = this->attValue.rawMoments;
-    std::vector <long long> &myBinaryMoments = this->attValue.binaryMoments;
+    // only read by the gray level moments, the binary moments are calculated without an image
+    const cv::Mat noImage;
+    const cv::Mat &img = this->grayCalc ? this->myTree->image() : noImage;
 
-    if (this->grayCalc)
-        std::fill(myRawMoments.begin(), myRawMoments.end(), 0);
-    std::fill(myBinaryMoments.begin(), myBinaryMoments.end(), 0);
+    this->attValue.clear();
+    MomentsHolder::RawMomentsArray &myBinaryMoments = this->attValue.binaryMoments;
+    MomentsHolder::RawMomentsArray &myRawMoments = this->attValue.rawMoments;
 
-    for (int i=0, szi = coords.size(); i < szi; ++i){
-        long long value = 1;
-        long long gValue = 0;
-        if (this->grayCalc)
-            gValue = fl::detail::getCvMatElem(this->myTree->image(), coords[i]);
-        for (int q_idx = 0; q_idx < order; ++q_idx){
-            long long h = value;
-            for (int p_idx = 0; p_idx < order-q_idx; ++p_idx){
-                if (this->grayCalc)
-                    myRawMoments[this->attValue.momIndex(p_idx,q_idx)] += h*gValue;
-                myBinaryMoments[this->attValue.momIndex(p_idx, q_idx)] += h;
-                h *= coords[i].X;
-            }
-            value *= coords[i].Y;
-        }
+    switch (this->attValue.order){
+        case 2:
+            if (this->grayCalc)
+                MomentsAttribute::accumulateOwnMoments<2, true>(coords, img, myBinaryMoments, myRawMoments);
+            else
+                MomentsAttribute::accumulateOwnMoments<2, false>(coords, img, myBinaryMoments, myRawMoments);
+            break;
+        case 3:
+            if (this->grayCalc)
+                MomentsAttribute::accumulateOwnMoments<3, true>(coords, img, myBinaryMoments, myRawMoments);
+            else
+                MomentsAttribute::accumulateOwnMoments<3, false>(coords, img, myBinaryMoments, myRawMoments);
+            break;
+        case 4:
+            if (this->grayCalc)
+                MomentsAttribute::accumulateOwnMoments<4, true>(coords, img, myBinaryMoments, myRawMoments);
+            else
+                MomentsAttribute::accumulateOwnMoments<4, false>(coords, img, myBinaryMoments, myRawMoments);
+            break;
+        case 5:
+        default:
+            if (this->grayCalc)
+                MomentsAttribute::accumulateOwnMoments<5, true>(coords, img, myBinaryMoments, myRawMoments);
+            else
+                MomentsAttribute::accumulateOwnMoments<5, false>(coords, img, myBinaryMoments, myRawMoments);
+            break;
     }
+
     std::vector <Attribute *> childAttributes;
     this->myNode->getChildrenAttributes(MomentsAttribute::name, childAttributes);
 
-    for (int i=0, szi = childAttributes.size(); i < szi; ++i){
-        const std::vector<long long> &childBMoments = ((MomentsAttribute *)childAttributes[i])->value().binaryMoments;
-        const std::vector<long long> &childGMoments = ((MomentsAttribute *)childAttributes[i])->value().rawMoments;
-        for (int j=0, szj = myBinaryMoments.size(); j < szj; ++j){
-            if (this->grayCalc)
-                myRawMoments[j] += childGMoments[j];
-            myBinaryMoments[j] += childBMoments[j];
-        }
-    }
+    for (int i=0, szi = childAttributes.size(); i < szi; ++i)
+        this->attValue.merge(((MomentsAttribute *)childAttributes[i])->value(), this->grayCalc);
+
     this->attValue.calculateDefaultCastValue();
 
     TypedAttribute<MomentsHolder>::calculateAttribute();
 }
 
+/// Accumulates the binary (and if \p gray is set, grayscale) moment sums of the order
+/// up to \p order - 1 for the given pixels. The powers of both coordinates are computed
+/// once per pixel, and all the moment sums are kept in fixed size local arrays, which
+/// lets the compiler fully unroll and vectorise the inner loops for each \p order.
+///
+/// \tparam order The order of the `MomentsHolder` (between 2 and 5).
+/// \tparam gray `true` to accumulate the grayscale moments.
+///
+/// \param coords The pixels of the region.
+/// \param img The image with the pixel values. Only read if \p gray is `true`.
+/// \param binaryMoments Output, the binary moment sums are added here.
+/// \param rawMoments Output, the grayscale moment sums are added here.
+template <int order, bool gray>
+void fl::MomentsAttribute::accumulateOwnMoments(const std::vector <std::pair <int, int> > &coords, const cv::Mat &img,
+                                                MomentsHolder::RawMomentsArray &binaryMoments, MomentsHolder::RawMomentsArray &rawMoments){
+    const int nMoments = order * (order + 1) / 2;
+    long long bm[nMoments] = {0};
+    long long rm[nMoments] = {0};
+
+    for (int i=0, szi = coords.size(); i < szi; ++i){
+        long long xp[order], yq[order];
+        xp[0] = yq[0] = 1;
+        for (int k = 1; k < order; ++k){
+            xp[k] = xp[k-1] * coords[i].X;
+            yq[k] = yq[k-1] * coords[i].Y;
+        }
+        long long gValue = gray ? (long long)fl::detail::getCvMatElem(img, coords[i]) : 0;
+
+        for (int q = 0, idx = 0; q < order; ++q){
+            for (int p = 0; p < order-q; ++p, ++idx){
+                long long h = xp[p] * yq[q];
+                bm[idx] += h;
+                if (gray)
+                    rm[idx] += h * gValue;
+            }
+        }
+    }
+
+    for (int j = 0; j < nMoments; ++j){
+        binaryMoments[j] += bm[j];
+        if (gray)
+            rawMoments[j] += rm[j];
+    }
+}
+
 fl::MomentsHolder & fl::MomentsAttribute::value(){
     bool &vset = this->vset();
     switch (((fl::MomentsSettings *)(this->getSettings()))->defaultCastValue){
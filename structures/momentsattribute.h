@@ -7,6 +7,8 @@
 #include "attribute.h"
 #include "momentsholder.h"
 
+#include <opencv2/core/core.hpp>
+
 namespace fl{
 /// \class MomentsSettings
 ///
@@ -78,6 +80,11 @@ namespace fl{
             virtual bool changeSettings(AttributeSettings *nsettings, bool deleteSettings = false);
         private:
             bool grayCalc;
+
+            /// \brief Accumulates the moment sums of the own elements of the `Node` for a fixed \p order.
+            template <int order, bool gray>
+            static void accumulateOwnMoments(const std::vector <std::pair <int, int> > &coords, const cv::Mat &img,
+                                             MomentsHolder::RawMomentsArray &binaryMoments, MomentsHolder::RawMomentsArray &rawMoments);
     };
 }
 
@@ -20,7 +20,11 @@
  */
 
 fl::MomentsHolder::~MomentsHolder(){}
-fl::MomentsHolder::MomentsHolder() : meanSet(false), binMeanSet(false) {}
+fl::MomentsHolder::MomentsHolder() : order(2), nMoments(3), meanSet(false), binMeanSet(false) {
+    this->binaryMoments.fill(0);
+    this->rawMoments.fill(0);
+    this->clear();
+}
 
 /// Return the value of the raw binary moment of the order ( \p `p` + \p `q` ).
 ///
@@ -54,9 +58,9 @@ long long fl::MomentsHolder::getRawMoment(int p, int q) const{
 /// were calculated.
 double fl::MomentsHolder::getCentralMoment(int p, int q, bool binCalc){
 
-    std::vector <long long> *rm;
-    std::vector <double> *cm;
-    std::vector <bool> *isSet;
+    RawMomentsArray *rm;
+    MomentsArray *cm;
+    MomentsSetArray *isSet;
     bool *ms;
     std::pair <double, double> * mean;
 
@@ -127,8 +131,8 @@ double fl::MomentsHolder::getCentralMoment(int p, int q, bool binCalc){
 /// previously been calculated.
 double fl::MomentsHolder::getCentralMomentNoCheck(int p, int q, bool binCalc) const{
     int curIndex = this->momIndex(p,q);
-    const std::vector <double> *cm;
-    const std::vector <long long> *rm;
+    const MomentsArray *cm;
+    const RawMomentsArray *rm;
 
     if (binCalc){
         cm = &(this->binCentralMoments);
@@ -164,9 +168,9 @@ double fl::MomentsHolder::getCentralMomentNoCheck(int p, int q, bool binCalc) co
 double fl::MomentsHolder::getNormCentralMoment(int p, int q, bool binCalc){
     int curIndex = this->momIndex(p,q);
 
-    std::vector <bool> *isSet;
-    std::vector <double> *nm;
-    std::vector <long long> *rm;
+    MomentsSetArray *isSet;
+    MomentsArray *nm;
+    RawMomentsArray *rm;
 
     if (binCalc){
         isSet = &(this->binNormSet);
@@ -200,7 +204,7 @@ double fl::MomentsHolder::getNormCentralMoment(int p, int q, bool binCalc){
 /// previously been calculated.
 double fl::MomentsHolder::getNormCentralMomentNoCheck(int p, int q, bool binCalc) const{
     int curIndex = this->momIndex(p,q);
-    const std::vector <double> *nm;
+    const MomentsArray *nm;
 
     if (binCalc)
         nm = &(this->binNormalizedMoments);
@@ -404,23 +408,14 @@ void fl::MomentsHolder::init(int order){
     this->order = order;
     if (this->order < 2)
         this->order = 2;
-    else if (this->order > 5)
-        this->order = 5;
-
-    int vecSize = 1;
-    for (int i=2; i <= this->order; ++i)
-        vecSize += i;
-
-    this->binaryMoments.resize(vecSize, 0);
-    this->rawMoments.resize(vecSize, 0);
-    this->centralSet.resize(vecSize, false);
-    this->centralMoments.resize(vecSize, 0.0);
-    this->binCentralSet.resize(vecSize, false);
-    this->binCentralMoments.resize(vecSize, 0.0);
-    this->binNormSet.resize(vecSize, false);
-    this->binNormalizedMoments.resize(vecSize, 0.0);
-    this->normSet.resize(vecSize, false);
-    this->normalizedMoments.resize(vecSize, 0.0);
+    else if (this->order > MomentsHolder::maxOrder)
+        this->order = MomentsHolder::maxOrder;
+
+    this->nMoments = this->order * (this->order + 1) / 2;
+
+    this->binaryMoments.fill(0);
+    this->rawMoments.fill(0);
+    this->clear();
 
     this->defaultValue = MomentType::raw;
     this->dp = this->dq = 0;
@@ -428,12 +423,40 @@ void fl::MomentsHolder::init(int order){
 
 
 
-int fl::MomentsHolder::momIndex(int p, int q) const{
-    int prefix = 0;
-    for (int i=0, sum = this->order; i < q; ++i, --sum)
-        prefix += sum;
+/// Resets all the raw moment sums to 0 and marks all the centralized and normalized
+/// moments (as well as the region mean) as not calculated.
+///
+/// \note The whole fixed size storage is reset, not only the part used by the current order.
+void fl::MomentsHolder::clear(){
+    this->binaryMoments.fill(0);
+    this->rawMoments.fill(0);
+    this->centralSet.fill(false);
+    this->centralMoments.fill(0.0);
+    this->binCentralSet.fill(false);
+    this->binCentralMoments.fill(0.0);
+    this->binNormSet.fill(false);
+    this->binNormalizedMoments.fill(0.0);
+    this->normSet.fill(false);
+    this->normalizedMoments.fill(0.0);
+    this->meanSet = this->binMeanSet = false;
+}
+
+/// Adds the raw moment sums of \p other to the ones of this `MomentsHolder`. As the unused
+/// part of the fixed size storage is always 0, the merge is a straight addition of
+/// the whole arrays.
+///
+/// \param other The `MomentsHolder` of a child region, of the same order.
+/// \param grayCalc Set to `true` to merge the grayscale moments as well as the binary ones.
+void fl::MomentsHolder::merge(const MomentsHolder &other, bool grayCalc){
+    for (int i=0; i < MomentsHolder::maxMoments; ++i)
+        this->binaryMoments[i] += other.binaryMoments[i];
+    if (grayCalc)
+        for (int i=0; i < MomentsHolder::maxMoments; ++i)
+            this->rawMoments[i] += other.rawMoments[i];
+}
 
-    return p+prefix;
+int fl::MomentsHolder::momIndex(int p, int q) const{
+    return p + q * this->order - q * (q - 1) / 2;
 }
 
 void fl::MomentsHolder::calculateDefaultCastValue(void){
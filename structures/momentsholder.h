@@ -4,6 +4,7 @@
 #ifndef MOMENTSHOLDER_H
 #define MOMENTSHOLDER_H
 
+#include <array>
 #include <string>
 #include <vector>
 
@@ -37,6 +38,20 @@ namespace fl{
     /// is determined by `MomentType` set by `MomentsHolder::setDefaultCastValue`
     class MomentsHolder{
         public:
+            /// \brief The highest supported value of the `MomentsHolder` order.
+            static const int maxOrder = 5;
+
+            /// \brief The number of moments stored for the highest supported order.
+            static const int maxMoments = maxOrder * (maxOrder + 1) / 2;
+
+            /// \brief Fixed size storage for the raw (binary or grayscale) moment sums.
+            typedef std::array <long long, maxMoments> RawMomentsArray;
+
+            /// \brief Fixed size storage for the derived (central or normalized) moments.
+            typedef std::array <double, maxMoments> MomentsArray;
+
+            /// \brief Fixed size storage for the indicators of calculated derived moments.
+            typedef std::array <bool, maxMoments> MomentsSetArray;
 
             /// \brief Constructor for `MomentsHolder`.
             MomentsHolder();
@@ -141,16 +156,17 @@ namespace fl{
         private:
             // maybe not, duplicating info? delete moments and pass as a param?
             int order;
-            std::vector <long long> binaryMoments;
-            std::vector <long long> rawMoments;
-            std::vector <bool> centralSet;
-            std::vector <double> centralMoments;
-            std::vector <bool> binCentralSet;
-            std::vector <double> binCentralMoments;
-            std::vector <bool> binNormSet;
-            std::vector <double> binNormalizedMoments;
-            std::vector <bool> normSet;
-            std::vector <double> normalizedMoments;
+            int nMoments;
+            RawMomentsArray binaryMoments;
+            RawMomentsArray rawMoments;
+            MomentsSetArray centralSet;
+            MomentsArray centralMoments;
+            MomentsSetArray binCentralSet;
+            MomentsArray binCentralMoments;
+            MomentsSetArray binNormSet;
+            MomentsArray binNormalizedMoments;
+            MomentsSetArray normSet;
+            MomentsArray normalizedMoments;
 
             static double kurtosisCalc(double bnm40, double bnm20);
             static double roundnessCalc(long long bm00, double bcm20, double bcm02);
@@ -164,6 +180,12 @@ namespace fl{
             /// \brief Initializes the holders for different types of moments.
             void init(int order);
 
+            /// \brief Resets the raw moment sums and invalidates all the derived moments.
+            void clear();
+
+            /// \brief Adds the raw moment sums of another `MomentsHolder` of the same order.
+            void merge(const MomentsHolder &other, bool grayCalc);
+
             bool meanSet;
             std::pair<double, double> negMean;
             bool binMeanSet;
@@ -1,10 +1,14 @@
 #include "node.h"
 
 #include <functional>
+#include <mutex>
 
 using namespace fl;
 
 std::vector<Node::anyFilter> Node::filteringOptions(0);
+/// \brief Ensures that `Node::filteringOptions` are set up once, also when the first
+/// `Node`s are created concurrently.
+static std::once_flag filteringOptionsSet;
 
 /// Constructor initializing internal `Node` elements (pixels).
 ///
@@ -12,8 +16,9 @@ std::vector<Node::anyFilter> Node::filteringOptions(0);
 Node::Node(const std::vector< std::pair< int, int > >& S)
         : _S(S),  _propagatingContrast(0), sizeKnown(false), ncountKnown(false) {
     this->setParent(NULL);
-    if (Node::filteringOptions.empty())
-        this->setFilteringFunctions();
+    this->_pre = this->_post = -1;
+    this->_pixelMap = NULL;
+    std::call_once(filteringOptionsSet, &Node::setFilteringFunctions, this);
 }
 
 /// Constructor initializing internal `Node` elements (pixels),
@@ -29,8 +34,9 @@ Node::Node(const std::vector< std::pair< int, int > >& S,
     for (int i=0, szi = this->_children.size(); i < szi; ++i){
         this->_children[i]->setParent(this);
     }
-    if (Node::filteringOptions.empty())
-        this->setFilteringFunctions();
+    this->_pre = this->_post = -1;
+    this->_pixelMap = NULL;
+    std::call_once(filteringOptionsSet, &Node::setFilteringFunctions, this);
 }
 
 Node::Node(const Node& other)
@@ -42,8 +48,9 @@ Node::Node(const Node& other)
         referenceImg(other.referenceImg), size(other.size), ncount(other.ncount) {
     //this->attributes.insert(other.attributes.begin(), other.attributes.end());
     //this->patternspectra.insert(other.patternspectra.being(), other.patternspectra.end());
-    if (Node::filteringOptions.empty())
-        this->setFilteringFunctions();
+    this->_pre = this->_post = -1;
+    this->_pixelMap = NULL;
+    std::call_once(filteringOptionsSet, &Node::setFilteringFunctions, this);
 }
 
 /// Allows to access an ancestral `Node` removed for \p depth
@@ -58,11 +65,15 @@ Node::Node(const Node& other)
 /// \note Calling this function without a parameter and using
 /// the default \p depth = 1 returns the direct parent of the
 /// `Node`
+///
+/// \note Takes O(\p depth) steps. For many queries, use the index
+/// returned by `ImageTree::levelAncestors()`, answering them in
+/// O(log \p depth).
 Node* Node::parent(int depth) const {
-    if (depth<=1 || this->_parent == NULL)
-        return this->_parent;
-    else
-        return this->_parent->parent(depth-1);
+    Node *cur = this->_parent;
+    for (; depth > 1 && cur != NULL; --depth)
+        cur = cur->_parent;
+    return cur;
 }
 
 /// Allows to access an ancestral `Node` which is the largest one
@@ -86,21 +97,24 @@ Node* Node::parent(int depth) const {
 /// used for its standard functionality._
 ///
 /// \return A pointer to the appropriate parent or ancestral `Node`.
+///
+/// \note Walks up the branch one `Node` at a time. For many queries,
+/// use `LevelAncestors::parentBySize()`, which finds the ancestor
+/// in O(log n).
 Node *Node::parentBySize(double perc, int oriSize, int jumps){
-//    if (oriSize == 0) // old implementation. Should be fine
-//        oriSize = this->elementCount();
-//
-//    if (this->parent() == NULL || (((double)this->parent()->elementCount()) / (double)oriSize) > perc){
-//        if (!jumps && this->parent() && (((double)this->parent()->elementCount()) / (double)oriSize) < (1.6*perc)){
-//            return this->parent();
-//        }
-//        return this;
-//    }
-//
-//    return this->parent()->parentBySize(perc, oriSize, jumps+1);
-    std::vector <Node *> dummy;
-    this->parentBySize(perc, dummy, oriSize, jumps);
-    return dummy.back();
+    if (oriSize == 0)
+        oriSize = this->elementCount();
+
+    Node *cur = this;
+    for (;; ++jumps){
+        Node *par = cur->parent();
+        if (par == NULL || (((double)par->elementCount()) / (double)oriSize) > perc){
+            if (!jumps && par && (((double)par->elementCount()) / (double)oriSize) < (1.6*perc))
+                return par;
+            return cur;
+        }
+        cur = par;
+    }
 }
 
 /// Allows to access an ancestral `Node` which is the largest one
@@ -137,15 +151,16 @@ void Node::parentBySize(double perc, std::vector<Node *> &pathBetween, int oriSi
     if (oriSize == 0)
         oriSize = this->elementCount();
 
-    if (this->parent() == NULL || (((double)this->parent()->elementCount()) / (double)oriSize) > perc){
-        if (!jumps && this->parent() && (((double)this->parent()->elementCount()) / (double)oriSize) < (1.6*perc)){
-            pathBetween.push_back(this->parent());
+    for (Node *cur = this;; ++jumps){
+        Node *par = cur->parent();
+        if (par == NULL || (((double)par->elementCount()) / (double)oriSize) > perc){
+            if (!jumps && par && (((double)par->elementCount()) / (double)oriSize) < (1.6*perc))
+                pathBetween.push_back(par);
+            return;
         }
-        return;
+        pathBetween.push_back(par);
+        cur = par;
     }
-
-    this->parent()->parentBySize(perc, pathBetween, oriSize, jumps+1);
-    return;
 }
 
 /// \return true if the `Node` is a root `Node`, false otherwise.
@@ -168,11 +183,29 @@ bool Node::isRoot() const {
 /// \remark Invalidates the values stored by:
 /// - `elementCount()`
 /// - `nodeCount()`
+///
+/// \note If the `Node` belongs to an `ImageTree`, the pixels of \p ch are assigned to
+/// their `Node`s in the pixel index (cf. `ImageTree::nodeAt()`), and `hasElement()`
+/// falls back to searching the subtree for this `Node` and its ancestors.
 void Node::addChild(Node* ch){
     this->_children.push_back(ch);
     ch->setParent(this);
     this->sizeKnown = false;
     this->ncountKnown = false;
+    if (this->_pixelMap != NULL){
+        std::vector <Node *> toProcess(1, ch);
+        while (!toProcess.empty()){
+            Node *cur = toProcess.back();
+            toProcess.pop_back();
+            cur->_pixelMap = this->_pixelMap;
+            cur->_pre = cur->_post = -1;
+            for (int i=0, szi = cur->_S.size(); i < szi; ++i)
+                if (cur->_S[i].X >= 0 && cur->_S[i].Y >= 0 && cur->_S[i].X < this->_pixelMap->width && cur->_S[i].Y < this->_pixelMap->height)
+                    this->_pixelMap->nodes[(size_t)cur->_S[i].Y * this->_pixelMap->width + cur->_S[i].X] = cur;
+            toProcess.insert(toProcess.end(), cur->_children.begin(), cur->_children.end());
+        }
+        this->dropPreorderRanges();
+    }
     this->checkConstraints();
     return;
 }
@@ -188,9 +221,18 @@ void Node::addChild(Node* ch){
 ///
 /// \remark Invalidates the values stored by:
 /// - `elementCount()`
+///
+/// \note If the `Node` belongs to an `ImageTree`, the pixel index is updated
+/// (cf. `ImageTree::nodeAt()`).
 void Node::addElement(const std::pair< int, int >& px){
     this->_S.push_back(px);
     this->sizeKnown = false;
+    if (this->_pixelMap != NULL){
+        if (px.X >= 0 && px.Y >= 0 && px.X < this->_pixelMap->width && px.Y < this->_pixelMap->height)
+            this->_pixelMap->nodes[(size_t)px.Y * this->_pixelMap->width + px.X] = this;
+        else // not in the index, the ranges can not answer for it
+            this->dropPreorderRanges();
+    }
     this->checkConstraints();
     return;
 }
@@ -224,7 +266,18 @@ const std::vector< std::pair< int, int > >& Node::getOwnElements() const{
 ///
 /// \return `true` if the `Node` contains \param px. `false`
 /// otherwise
-bool Node::hasElement(const std::pair<int, int> &px) const{
+///
+/// \note O(1) if the `Node` belongs to an `ImageTree` (cf. `ImageTree::nodeAt()`),
+/// otherwise the own elements of the whole subtree are searched.
+bool Node::hasElement(const std::pair<int, int> &px) const{
+    // indexed by an ImageTree: ancestor test on the preorder ranges, O(1)
+    if (this->_pixelMap != NULL && this->_pre >= 0){
+        if (px.X < 0 || px.Y < 0 || px.X >= this->_pixelMap->width || px.Y >= this->_pixelMap->height)
+            return false;
+        const Node *owner = this->_pixelMap->nodes[(size_t)px.Y * this->_pixelMap->width + px.X];
+        return owner != NULL && this->_pre <= owner->_pre && owner->_pre < this->_post;
+    }
+
 //    recursive:
 //    if (std::find(this->_S.begin(), this->_S.end(), px) != this->_S.end())
 //        return true;
@@ -589,6 +642,10 @@ bool Node::deleteChild(int childIndex){
             this->_children[i]->_parent = this;
     }
     this->_S.insert(this->_S.end(), toDelete->_S.begin(), toDelete->_S.end());
+    if (this->_pixelMap != NULL){
+        for (int i=0, szi = toDelete->_S.size(); i < szi; ++i)
+            this->_pixelMap->nodes[(size_t)toDelete->_S[i].Y * this->_pixelMap->width + toDelete->_S[i].X] = this;
+    }
 
 
     Node *crt = toDelete;
@@ -652,6 +709,15 @@ bool Node::deleteChildWithRule(int childIndex, int rule){
            //(this->*(this->filteringOptions[rule]))(childIndex);
 }
 
+/// Called when the subtree of the `Node` changes in a way the preorder ranges
+/// assigned by the `ImageTree` can not follow. `hasElement()` then searches the
+/// subtree for this `Node` and its ancestors, while the pixel index is still kept
+/// up to date.
+void Node::dropPreorderRanges(){
+    for (Node *cur = this; cur != NULL && cur->_pre >= 0; cur = cur->isRoot() ? NULL : cur->_parent)
+        cur->_pre = cur->_post = -1;
+}
+
 /// \param p `Node *` pointer to a new parent `Node`.
 void Node::setParent(Node* p){
     this->_parent = p; return;
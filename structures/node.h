@@ -30,6 +30,18 @@ namespace fl{
     class AnyPatternSpectra2D;
 #endif
 
+    class Node;
+    class LevelAncestors;
+
+    namespace detail{
+        /// \brief The `Node` holding each pixel of an image as own element. Kept
+        /// up to date by `Node::deleteChild()` when pixels move to another `Node`.
+        struct PixelNodeMap{
+            int width, height;
+            std::vector <Node *> nodes;
+        };
+    }
+
 /// \class Node
 ///
 /// \brief Abstract `Node`, single element of a component tree
@@ -158,16 +170,17 @@ namespace fl{
             // friends and algorithms:
 
             friend std::pair<int, bool> mserRecursive(Node *root, const int deltaLvl, std::vector <Node * > &mserOrder, int minArea, double maxVariation);
-            friend std::pair<int, bool> mserRecursive(Node *root, const int deltaLvl, std::vector <Node * > &mserOrder, std::vector <std::pair<double, int> > &div,
+            friend std::pair<int, bool> mserRecursive(const LevelAncestors &anc, Node *root, const int deltaLvl, std::vector <Node * > &mserOrder, std::vector <std::pair<double, int> > &div,
                            int minArea, double maxVariation);
 
             friend Node *constructRecursively(Node *root, std::vector <std::vector <char> > &seen);
 
             template <typename Compare>
             friend Node *maxTreeNister(const cv::Mat &img, Compare pxOrder, pxType curType);
-            friend std::pair <int, bool> areaDiff(Node *root, const int deltaLvl);
 
             friend class ImageTree;
+            friend class FilteredTreeView;
+            friend class FrozenTree;
 
     protected:
 
@@ -319,6 +332,17 @@ namespace fl{
             /// The number of `Node`s in the subtree.
             int ncount;
 
+            /// \brief Preorder number of the `Node`, and the end of the (half-open)
+            /// preorder range of its subtree. Assigned by `ImageTree`, -1 if not assigned.
+            int _pre, _post;
+
+            /// \brief The pixel-to-`Node` map of the `ImageTree` holding the `Node`,
+            /// `NULL` if none.
+            detail::PixelNodeMap *_pixelMap;
+
+            /// \brief Stop using the preorder ranges for this `Node` and its ancestors.
+            void dropPreorderRanges();
+
   };
 
 }
@@ -6,6 +6,7 @@
 #include "node.h"
 #include "imagetree.h"
 #include "areaattribute.h"
+#include "compiledbinning.h"
 
 #include <iostream>
 
@@ -35,6 +36,7 @@ fl::Binning::Binning(int nBins, int minValue, int maxValue, Scale sc)
         std::cerr << "Initializing arbitrairy binning without limit values. Releasing raptors" << std::endl;
         std::exit(-1);
     }
+    this->compile();
 }
 
 /// This constructor can be used to set up `Binning::logarithmic` when the base of
@@ -57,6 +59,7 @@ fl::Binning::Binning(int nBins, int minValue, int maxValue, Scale sc, int refere
         std::cerr << "referenceScaleRange argument used only in initialization of logarithmic binning. Releasing raptors" << std::endl;
         std::exit(-7);
     }
+    this->compile();
 }
 
 /// This constructor can be used to set up `Binning::arbitrary` when the base of
@@ -91,6 +94,7 @@ fl::Binning::Binning(int nBins, int minValue, int maxValue, Scale sc, const std:
             std::exit(-4);
         }
     }
+    this->compile();
 }
 
 /// For the given value, determine the bin index. Takes into account the
@@ -100,7 +104,26 @@ fl::Binning::Binning(int nBins, int minValue, int maxValue, Scale sc, const std:
 /// \remark Should be between `Binning::minValue` and `Binning::maxValue`
 /// \return The index of the correct bin.
 /// \remark The indexes are one-valued. The bins `0` and `Binning::maxValue`ss
+///
+/// \note Uses the precomputed `CompiledBinning` when available.
 int fl::Binning::getBin(double value) const{
+    return this->compiled ? this->compiled->getBin(value) : this->getBinDirect(value);
+}
+
+/// \param values The values for which the bins should be determined.
+/// \param bins Output, the index of the bin of each value.
+/// \param n The number of values.
+void fl::Binning::getBins(const double *values, int *bins, int n) const{
+    if (this->compiled){
+        this->compiled->getBins(values, bins, n);
+        return;
+    }
+    for (int i=0; i < n; ++i)
+        bins[i] = this->getBinDirect(values[i]);
+}
+
+/// Determines the bin with the formula (or the search) of the `Binning::Scale`.
+int fl::Binning::getBinDirect(double value) const{
     if (value >= this->maxValue)
         return nBins+1;
     else if (value < this->minValue)
@@ -178,6 +201,14 @@ void fl::Binning::calcLogB(){
     this->b = std::pow(this->referenceScaleRange, 1.0/this->nBins);
 }
 
+/// Precomputes the `Binning` (cf. `CompiledBinning`). Skipped while the range
+/// is relative (`NODE_VAL`).
+void fl::Binning::compile(){
+    this->compiled.reset();
+    if (this->maxValue != NODE_VAL)
+        this->compiled = std::make_shared <const CompiledBinning>(*this);
+}
+
 
 /// Returns the upper limit of the bin \param binIndex as a
 /// percentage (the upper limit of the last bin is `1.0`)
@@ -209,15 +240,23 @@ double fl::Binning::getUnscaledUpperLimit(int binIndex) const{
 /// \param myNode The `Node` in which a histogram with this `Binning` will
 /// be assigned.
 void fl::Binning::addLocalInformation(Node *myNode){
-    if (this->maxValue == NODE_VAL){
-        this->maxValue = ((AreaAttribute *)(myNode->getAttribute(AreaAttribute::name)))->value();
-        this->range = this->maxValue - this->minValue;
-        if (this->scale == Scale::logarithmic && this->referenceScaleRange <= 0){
-            this->referenceScaleRange = this->range + 1;
-            this->calcLogB();
-        }
-        this->relativeScale = true;
+    if (this->maxValue == NODE_VAL)
+        this->setLocalRange(((AreaAttribute *)(myNode->getAttribute(AreaAttribute::name)))->value());
+}
+
+/// Sets the maximum (and the derived logarithm base) of a `Binning` with relative
+/// size (set up with `NODE_VAL`), e.g. to the area of a `Node` or of an image window.
+///
+/// \param maxValue The reference size, used as `Binning::maxValue`.
+void fl::Binning::setLocalRange(int maxValue){
+    this->compiled.reset();
+    this->maxValue = maxValue;
+    this->range = this->maxValue - this->minValue;
+    if (this->scale == Scale::logarithmic && this->referenceScaleRange <= 0){
+        this->referenceScaleRange = this->range + 1;
+        this->calcLogB();
     }
+    this->relativeScale = true;
 }
 
 /// Initializes all the necessary settings for fully defining a `PatternSpectra2D`.
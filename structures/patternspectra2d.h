@@ -8,6 +8,7 @@
 #include <vector>
 #include <utility>
 #include <cmath>
+#include <memory>
 
 #include "attribute.h"
 
@@ -36,6 +37,7 @@
 namespace fl{
     class ImageTree;
     class Node;
+    class CompiledBinning;
 
     /// \class Binning
     ///
@@ -61,6 +63,9 @@ namespace fl{
             /// \brief Determine the bin index for a value.
             int getBin(double value) const;
 
+            /// \brief Determine the bin indexes for an array of values.
+            void getBins(const double *values, int *bins, int n) const;
+
             int nBins; ///< The number of bins for a 1D `Binning`.
             int minValue; ///< The minimal attribute value accepted by this `Binning`.
             int maxValue; ///< The maximal attribute value accepted by this `Binning`.
@@ -102,11 +107,16 @@ namespace fl{
         protected:
 
             friend class AnyPatternSpectra2D;
+            friend class ImageTree;
+            friend class CompiledBinning;
 
             /// \brief Associate the information specific to a `Node` which
             /// is locally used for the `PatternSpectra2D`.
             void addLocalInformation(Node *myNode);
 
+            /// \brief Use \p maxValue as the maximum of a `Binning` set up with `NODE_VAL`.
+            void setLocalRange(int maxValue);
+
         private:
             int range, referenceScaleRange;
             double b;
@@ -119,6 +129,16 @@ namespace fl{
             void calcLogB();
             const std::vector <double> binUpperLimits;
 
+            /// \brief The precomputed form of this `Binning`, shared by its copies. Not
+            /// set while the range is relative (`NODE_VAL`).
+            std::shared_ptr <const CompiledBinning> compiled;
+
+            /// \brief Determine the bin index for a value, without the precomputed form.
+            int getBinDirect(double value) const;
+
+            /// \brief Build the precomputed form of this `Binning`.
+            void compile();
+
     };
 
 /// \class PatternSpectra2DSettings
@@ -143,6 +163,7 @@ namespace fl{
             std::vector <double> upperLimits;
 
             friend class AnyPatternSpectra2D;
+            friend class ImageTree;
 
             template <typename AT1, typename AT2>
             friend class PatternSpectra2D;
@@ -204,6 +225,10 @@ namespace fl{
 
             /// \copydoc AnyPatternSpectra2D::getPatternSpectraMatrix()
             virtual const std::vector<std::vector<double> > &getPatternSpectraMatrix(std::vector<Node *> *pathDown = NULL);
+
+            /// \brief Determine the upper limits of the second `Attribute` bins used
+            /// with `PatternSpectra2DSettings` `cutOff`.
+            static void setCutOffLimits(PatternSpectra2DSettings *settings, AttributeSettings *secondAttSettings);
         protected:
             void calculatePatternSpectra2D(PatternSpectra2DSettings *baseSettings = NULL, std::vector<Node *> *pathDown = NULL);
             const std::vector<std::vector<double> > &getPatternSpectraMatrix(bool userCall, PatternSpectra2DSettings *settings, std::vector<Node *> *pathDown = NULL);
@@ -30,23 +30,34 @@ fl::PatternSpectra2D<AT1,AT2>::PatternSpectra2D(Node *baseNode, const ImageTree
                 pass = true;
             }
         }
-        if (!pass){ // failing that, construct its own upper limit
-            for (int i=0, szi = this->mySettings->firstAttBin.nBins; i < szi; ++i){
-                double percentageLimit = this->mySettings->firstAttBin.getUnscaledUpperLimit(i+1);
-                int upper = this->mySettings->firstAttBin.maxValue;
-                int lower = this->mySettings->firstAttBin.minValue;
-                int upperArea = percentageLimit * (upper-lower) + lower;
-
-                cv::Mat image = cv::Mat::zeros(upperArea, 1, CV_8U);
-                fl::Node *root =fl::maxTreeNister(image, std::greater<int>());
-                fl::ImageTree *tree = new fl::ImageTree(root,std::make_pair(image.rows, image.cols));
-                tree->setImage(image);
-                tree->addAttributeToTree<AT2>(this->myNode->getAttribute(AT2::name)->mySettings, false);
-                this->mySettings->upperLimits[i] = this->mySettings->secondAttBin.getBin(((AT2 *)root->getAttribute(AT2::name))->value());
-                tree->deleteAttributeFromTree<AT2>();
-                delete tree;
-            }
-        }
+        if (!pass) // failing that, construct its own upper limit
+            PatternSpectra2D<AT1,AT2>::setCutOffLimits(this->mySettings, this->myNode->getAttribute(AT2::name)->mySettings);
+    }
+}
+
+/// For every bin of the first `Attribute` (the area), finds the bin of the second
+/// `Attribute` of a region with the area equal to the upper limit of the bin, i.e.
+/// the highest bin of the second `Attribute` which can be reached by the regions
+/// falling into the bin of the first `Attribute`.
+///
+/// \param settings The `PatternSpectra2DSettings` in which to store the limits.
+/// \param secondAttSettings The `AttributeSettings` used to calculate the second `Attribute`.
+template <class AT1, class AT2>
+void fl::PatternSpectra2D<AT1,AT2>::setCutOffLimits(PatternSpectra2DSettings *settings, AttributeSettings *secondAttSettings){
+    for (int i=0, szi = settings->firstAttBin.nBins; i < szi; ++i){
+        double percentageLimit = settings->firstAttBin.getUnscaledUpperLimit(i+1);
+        int upper = settings->firstAttBin.maxValue;
+        int lower = settings->firstAttBin.minValue;
+        int upperArea = percentageLimit * (upper-lower) + lower;
+
+        cv::Mat image = cv::Mat::zeros(upperArea, 1, CV_8U);
+        fl::Node *root =fl::maxTreeNister(image, std::greater<int>());
+        fl::ImageTree *tree = new fl::ImageTree(root,std::make_pair(image.rows, image.cols));
+        tree->setImage(image);
+        tree->addAttributeToTree<AT2>(secondAttSettings, false);
+        settings->upperLimits[i] = settings->secondAttBin.getBin(((AT2 *)root->getAttribute(AT2::name))->value());
+        tree->deleteAttributeFromTree<AT2>();
+        delete tree;
     }
 }
 
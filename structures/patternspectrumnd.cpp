@@ -0,0 +1,120 @@
+/// \file structures/patternspectrumnd.cpp
+/// \author Petra Bosilj
+
+#include "patternspectrumnd.h"
+
+#include <algorithm>
+
+/// Histograms with at most this many cells are always stored densely.
+#define DENSE_CELL_LIMIT 4096
+
+/// A hash map entry takes about as much memory as this many dense cells.
+#define SPARSE_ENTRY_COST 5
+
+fl::PatternSpectrumND::PatternSpectrumND(){
+    this->reset(std::vector <int>());
+}
+
+/// \param dims The number of bins in every dimension (including the bins for the
+/// values out of range).
+fl::PatternSpectrumND::PatternSpectrumND(const std::vector <int> &dims){
+    this->reset(dims);
+}
+
+/// \param dims The number of bins in every dimension (including the bins for the
+/// values out of range).
+void fl::PatternSpectrumND::reset(const std::vector <int> &dims){
+    this->dims = dims;
+    this->strides.assign(dims.size(), 1);
+    this->cells = 1;
+    for (int i = dims.size()-1; i >= 0; --i){
+        this->strides[i] = this->cells;
+        this->cells *= dims[i];
+    }
+
+    this->sparseCells.clear();
+    this->sparse = (this->cells > DENSE_CELL_LIMIT);
+    if (this->sparse)
+        std::vector <double>().swap(this->dense);
+    else
+        this->dense.assign(this->cells, 0);
+}
+
+int fl::PatternSpectrumND::dimensions() const { return this->dims.size(); }
+
+const std::vector <int> &fl::PatternSpectrumND::shape() const { return this->dims; }
+
+long long fl::PatternSpectrumND::cellCount() const { return this->cells; }
+
+long long fl::PatternSpectrumND::nonZeroCount() const{
+    if (this->sparse)
+        return this->sparseCells.size();
+    return this->cells - std::count(this->dense.begin(), this->dense.end(), 0.0);
+}
+
+bool fl::PatternSpectrumND::isSparse() const { return this->sparse; }
+
+/// \param bins The bin in every dimension.
+long long fl::PatternSpectrumND::flatIndex(const std::vector <int> &bins) const{
+    long long index = 0;
+    for (int i=0, szi = this->dims.size(); i < szi; ++i)
+        index += bins[i] * this->strides[i];
+    return index;
+}
+
+/// Switches to the dense storage when the hash map becomes larger than the dense array.
+///
+/// \param index The flat index of the cell.
+/// \param value The value to add.
+void fl::PatternSpectrumND::add(long long index, double value){
+    if (!this->sparse){
+        this->dense[index] += value;
+        return;
+    }
+    this->sparseCells[index] += value;
+    if ((long long)this->sparseCells.size() * SPARSE_ENTRY_COST > this->cells)
+        this->densify();
+}
+
+/// \param index The flat index of the cell.
+double fl::PatternSpectrumND::value(long long index) const{
+    if (!this->sparse)
+        return this->dense[index];
+    std::unordered_map <long long, double>::const_iterator it = this->sparseCells.find(index);
+    return (it == this->sparseCells.end()) ? 0.0 : it->second;
+}
+
+/// \param bins The bin in every dimension.
+double fl::PatternSpectrumND::value(const std::vector <int> &bins) const{
+    return this->value(this->flatIndex(bins));
+}
+
+/// \param out Output, the values of all the `cellCount()` cells.
+void fl::PatternSpectrumND::toDense(std::vector <double> &out) const{
+    if (!this->sparse){
+        out = this->dense;
+        return;
+    }
+    out.assign(this->cells, 0);
+    for (std::unordered_map <long long, double>::const_iterator it = this->sparseCells.begin(); it != this->sparseCells.end(); ++it)
+        out[it->first] = it->second;
+}
+
+/// \param cells Output, the non-empty cells.
+void fl::PatternSpectrumND::nonZero(std::vector <std::pair <long long, double> > &cells) const{
+    cells.clear();
+    if (this->sparse){
+        cells.insert(cells.end(), this->sparseCells.begin(), this->sparseCells.end());
+        std::sort(cells.begin(), cells.end());
+        return;
+    }
+    for (long long i=0; i < this->cells; ++i)
+        if (this->dense[i] != 0)
+            cells.push_back(std::make_pair(i, this->dense[i]));
+}
+
+void fl::PatternSpectrumND::densify(){
+    this->toDense(this->dense);
+    std::unordered_map <long long, double>().swap(this->sparseCells);
+    this->sparse = false;
+}
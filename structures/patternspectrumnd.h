@@ -0,0 +1,84 @@
+/// \file structures/patternspectrumnd.h
+/// \author Petra Bosilj
+
+#ifndef PATTERNSPECTRUMND_H
+#define PATTERNSPECTRUMND_H
+
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+namespace fl{
+
+    /// \class PatternSpectrumND
+    ///
+    /// \brief The histogram of an N-dimensional pattern spectrum (one dimension per
+    /// `Attribute`), filled by `ImageTree::patternSpectrumND()`.
+    ///
+    /// Every dimension has `Binning::nBins` + 2 bins, the first and the last one
+    /// holding the values out of the range of the `Binning` (as in `PatternSpectra2D`).
+    /// The cells are addressed by a flat row-major index (the last dimension varying
+    /// the fastest).
+    ///
+    /// Small histograms are stored densely. Larger ones start as a hash map holding
+    /// only the non-empty cells, and are switched to the dense storage automatically
+    /// once the density of the non-empty cells makes the map larger than the dense array.
+    class PatternSpectrumND{
+        public:
+            /// \brief Constructor for an empty histogram with no dimensions.
+            PatternSpectrumND();
+
+            /// \brief Constructor for an empty histogram with the given number of bins
+            /// in every dimension.
+            PatternSpectrumND(const std::vector <int> &dims);
+
+            /// \brief Empty the histogram and set the number of bins in every dimension.
+            void reset(const std::vector <int> &dims);
+
+            /// \brief The number of dimensions.
+            int dimensions() const;
+
+            /// \brief The number of bins in every dimension.
+            const std::vector <int> &shape() const;
+
+            /// \brief The total number of cells.
+            long long cellCount() const;
+
+            /// \brief The number of non-empty cells.
+            long long nonZeroCount() const;
+
+            /// \brief Check if the non-empty cells are stored in the hash map.
+            bool isSparse() const;
+
+            /// \brief The flat index of the cell with the given bin in every dimension.
+            long long flatIndex(const std::vector <int> &bins) const;
+
+            /// \brief Add \p value to a cell.
+            void add(long long index, double value);
+
+            /// \brief The value of a cell.
+            double value(long long index) const;
+
+            /// \brief \copybrief value(long long index) const
+            double value(const std::vector <int> &bins) const;
+
+            /// \brief Write all the cells into a dense row-major array.
+            void toDense(std::vector <double> &out) const;
+
+            /// \brief List the non-empty cells as (flat index, value), ordered by index.
+            void nonZero(std::vector <std::pair <long long, double> > &cells) const;
+
+        private:
+            std::vector <int> dims;
+            std::vector <long long> strides;
+            long long cells;
+
+            bool sparse;
+            std::vector <double> dense;
+            std::unordered_map <long long, double> sparseCells;
+
+            void densify();
+    };
+}
+
+#endif // PATTERNSPECTRUMND_H
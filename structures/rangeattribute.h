@@ -4,7 +4,7 @@
 #ifndef RANGEATTRIBUTE_H
 #define RANGEATTRIBUTE_H
 
-#include "attribute.h"
+#include "valuestatisticsattribute.h"
 
 namespace fl{
 /// \class RangeSettings
@@ -30,7 +30,10 @@ namespace fl{
 ///
 /// \note The calculation of this attribute requires reading the pixel values. The corresponding image has to be
 /// assigned with `ImageTree::setImage()`.
-    class RangeAttribute : public TypedAttribute<double>
+///
+/// The value is obtained from the `ValueStatistics` of the region, shared with
+/// `MeanAttribute` and `ValueDeviationAttribute`.
+    class RangeAttribute : public ValueStatisticsAttribute
     {
         public:
             static const std::string name;
@@ -45,8 +48,6 @@ namespace fl{
             virtual void calculateAttribute();
         protected:
         private:
-            bool minSet, maxSet;
-            double minValue, maxValue;
     };
 }
 
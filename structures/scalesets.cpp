@@ -0,0 +1,225 @@
+/// \file structures/scalesets.cpp
+/// \author Petra Bosilj
+
+#include "scalesets.h"
+
+#include "imagetree.h"
+#include "node.h"
+#include "valuedeviationattribute.h"
+
+#include <algorithm>
+#include <limits>
+#include <iostream>
+#include <cstdlib>
+
+namespace fl{
+    namespace detail{
+
+        /// \class LeftistHeaps
+        ///
+        /// \brief A forest of leftist max-heaps over the `Node` indices, ordered by
+        /// \p key. A heap is identified by its top, -1 is the empty heap.
+        class LeftistHeaps{
+            public:
+                LeftistHeaps(const std::vector <double> &key)
+                    : key(key), left(key.size(), -1), right(key.size(), -1), rank(key.size(), 1) {}
+
+                int merge(int a, int b){
+                    if (a < 0) return b;
+                    if (b < 0) return a;
+                    if (this->key[a] < this->key[b])
+                        std::swap(a, b);
+                    this->right[a] = this->merge(this->right[a], b);
+                    if (this->rankOf(this->left[a]) < this->rankOf(this->right[a]))
+                        std::swap(this->left[a], this->right[a]);
+                    this->rank[a] = this->rankOf(this->right[a]) + 1;
+                    return a;
+                }
+
+                /// \brief The heap without its top \p a.
+                int pop(int a){
+                    return this->merge(this->left[a], this->right[a]);
+                }
+
+            private:
+                const std::vector <double> &key;
+                std::vector <int> left, right, rank;
+
+                int rankOf(int a) const { return a < 0 ? 0 : this->rank[a]; }
+        };
+    }
+}
+
+/// \param fidelity The goodness-of-fit term of a region.
+/// \param complexity The regularisation term of a region.
+/// \param pixelComplexity The complexity of a single pixel.
+fl::CutEnergy::CutEnergy(const RegionCost &fidelity, const RegionCost &complexity, double pixelComplexity)
+    : fidelity(fidelity), complexity(complexity), pixelComplexity(pixelComplexity) {}
+
+double fl::CutEnergy::regionCount(const Node * /*node*/){
+    return 1.0;
+}
+
+/// \note The `ValueDeviationAttribute` needs to be assigned to the `ImageTree`.
+double fl::CutEnergy::squaredError(const Node *node){
+    ValueDeviationAttribute *att = (ValueDeviationAttribute *)node->getAttribute(ValueDeviationAttribute::name);
+    if (att == NULL){
+        std::cerr << "ValueDeviationAttribute not assigned to the ImageTree, giving up." << std::endl;
+        std::exit(-2);
+    }
+    const ValueStatistics &stats = att->statistics();
+    return stats.variance() * stats.count();
+}
+
+/// Every `Node` is processed once its children are. The optimal energy of its
+/// subtree, for `lambda` larger than all the appearances in it, is the sum over the
+/// children (each as a region, or partitioned when it never appears) and the own
+/// pixels. The appearance of the `Node` is where this line meets the energy of the
+/// `Node` itself. While it is below the largest appearance left in the subtree,
+/// that `Node` can never be part of a cut: it is popped, and replaced in the sum by
+/// its own partition just below its appearance.
+///
+/// \param tree The `ImageTree` to index.
+/// \param energy The energy to minimise.
+fl::ScaleSets::ScaleSets(const ImageTree &tree, const CutEnergy &energy) : tree(&tree){
+    tree.topDownOrder(this->order, this->parentIdx);
+    int szn = this->order.size();
+    const double inf = std::numeric_limits<double>::infinity();
+
+    // costs are read sequentially, since attributes might be calculated on first access
+    std::vector <double> fidelity(szn), complexity(szn);
+    for (int i=0; i < szn; ++i){
+        fidelity[i] = energy.fidelity(this->order[i]);
+        complexity[i] = energy.complexity(this->order[i]);
+    }
+
+    // (intercept, slope) of the energy of the subtree above all appearances, and of
+    // the partition of a Node just below its appearance
+    std::vector <double> intercept(szn, 0.0), slope(szn, 0.0);
+    std::vector <double> lowIntercept(szn, 0.0), lowSlope(szn, 0.0);
+    std::vector <int> heap(szn, -1);
+    long long pixels = 0;
+    this->appear.assign(szn, inf);
+    detail::LeftistHeaps heaps(this->appear);
+
+    for (int i = szn-1; i >= 0; --i){
+        int own = this->order[i]->getOwnElements().size();
+        pixels += own;
+        double a = intercept[i], b = slope[i] + own * energy.pixelComplexity;
+        if (b > complexity[i]){
+            double lambda;
+            while (true){
+                lambda = (fidelity[i] - a) / (b - complexity[i]);
+                int top = heap[i];
+                if (top < 0 || lambda >= this->appear[top])
+                    break;
+                heap[i] = heaps.pop(top);
+                a += lowIntercept[top] - fidelity[top];
+                b += lowSlope[top] - complexity[top];
+            }
+            this->appear[i] = lambda;
+            lowIntercept[i] = a;
+            lowSlope[i] = b;
+            heap[i] = heaps.merge(heap[i], i);
+            a = fidelity[i];
+            b = complexity[i];
+        }
+
+        int p = this->parentIdx[i];
+        if (p >= 0){
+            intercept[p] += a;
+            slope[p] += b;
+            heap[p] = heaps.merge(heap[p], heap[i]);
+        }
+    }
+
+    this->disappear.assign(szn, inf);
+    for (int i=1; i < szn; ++i){
+        int p = this->parentIdx[i];
+        this->disappear[i] = std::min(this->disappear[p], this->appear[p]);
+    }
+
+    // the Nodes left in the heap of the root, from the finest cut (only pixels) up
+    std::vector <int> left;
+    for (int i=0; i < szn; ++i)
+        if (this->persistent(i))
+            left.push_back(i);
+    const std::vector <double> &appear = this->appear;
+    std::sort(left.begin(), left.end(), [&](int x, int y){ return appear[x] < appear[y]; });
+
+    double a = 0.0, b = pixels * energy.pixelComplexity;
+    for (int j=0, szj = left.size(); j < szj; ++j){
+        int i = left[j];
+        if (j == 0 || this->appear[i] != this->appear[left[j-1]]){
+            this->curveIntercept.push_back(a);
+            this->curveSlope.push_back(b);
+            this->breakpoints.push_back(this->appear[i]);
+        }
+        a += fidelity[i] - lowIntercept[i];
+        b += complexity[i] - lowSlope[i];
+    }
+    this->curveIntercept.push_back(a);
+    this->curveSlope.push_back(b);
+}
+
+int fl::ScaleSets::size() const { return this->order.size(); }
+
+/// \param i The index of the `Node`.
+fl::Node *fl::ScaleSets::node(int i) const { return this->order[i]; }
+
+/// \param i The index of the `Node`.
+///
+/// \return Infinity for a `Node` which is never better than its partitions.
+double fl::ScaleSets::appearance(int i) const { return this->appear[i]; }
+
+/// \param i The index of the `Node`.
+double fl::ScaleSets::disappearance(int i) const { return this->disappear[i]; }
+
+/// \param i The index of the `Node`.
+///
+/// \note A `Node` appearing where it disappears is optimal only for that `lambda`, tied
+/// with the ancestor replacing it; `cut()` gives the ancestor.
+bool fl::ScaleSets::persistent(int i) const{
+    return this->appear[i] < std::numeric_limits<double>::infinity() && this->appear[i] <= this->disappear[i];
+}
+
+const std::vector <double> &fl::ScaleSets::scales() const { return this->breakpoints; }
+
+/// \param lambda The weight of the complexity.
+double fl::ScaleSets::energy(double lambda) const{
+    int k = std::upper_bound(this->breakpoints.begin(), this->breakpoints.end(), lambda) - this->breakpoints.begin();
+    return this->curveIntercept[k] + lambda * this->curveSlope[k];
+}
+
+void fl::ScaleSets::regions(double lambda, std::vector <int> &region) const{
+    int szn = this->order.size();
+    region.assign(szn, -1);
+    for (int i=0; i < szn; ++i){
+        int p = this->parentIdx[i];
+        if (p >= 0 && region[p] >= 0)
+            region[i] = region[p];
+        else if (this->appear[i] <= lambda && lambda < this->disappear[i])
+            region[i] = i;
+    }
+}
+
+/// \param lambda The weight of the complexity.
+/// \param regions Output, the `Node`s forming the regions of the cut. The pixels not
+/// covered by them are regions on their own.
+void fl::ScaleSets::cut(double lambda, std::vector <Node *> &regions) const{
+    std::vector <int> region;
+    this->regions(lambda, region);
+    regions.clear();
+    for (int i=0, szi = region.size(); i < szi; ++i)
+        if (region[i] == i)
+            regions.push_back(this->order[i]);
+}
+
+/// \param lambda The weight of the complexity.
+/// \param labels Output, the label image (`CV_32S`) with the regions numbered
+/// from 0 in the raster order of their first pixel.
+void fl::ScaleSets::cut(double lambda, cv::Mat &labels) const{
+    std::vector <int> region;
+    this->regions(lambda, region);
+    this->tree->labelRegions(this->order, region, labels);
+}
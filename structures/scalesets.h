@@ -0,0 +1,114 @@
+/// \file structures/scalesets.h
+/// \author Petra Bosilj
+
+#ifndef SCALESETS_H
+#define SCALESETS_H
+
+#include <vector>
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+
+namespace fl{
+
+    class ImageTree;
+    class Node;
+
+    /// \class CutEnergy
+    ///
+    /// \brief The energy of a partition formed by the regions of an `ImageTree`:
+    /// the sum over the regions `R` of `fidelity(R) + lambda * complexity(R)`.
+    ///
+    /// The own pixels of a `Node` which is not covered by a region of the cut are
+    /// regions on their own, with no fidelity cost and `pixelComplexity` each.
+    ///
+    /// \note `ScaleSets` requires the complexity of a `Node` to be smaller than the
+    /// total complexity of any partition of it into its descendants and pixels (as
+    /// for `regionCount()` or the length of the boundary). The `Node`s for which this
+    /// does not hold are never part of a cut.
+    class CutEnergy{
+        public:
+            typedef std::function <double(const Node *)> RegionCost;
+
+            /// \brief Constructor for `CutEnergy`.
+            CutEnergy(const RegionCost &fidelity, const RegionCost &complexity = CutEnergy::regionCount, double pixelComplexity = 1.0);
+
+            /// \brief The goodness-of-fit term of a region.
+            RegionCost fidelity;
+            /// \brief The regularisation term of a region, weighted by `lambda`.
+            RegionCost complexity;
+            /// \brief The complexity of a single pixel.
+            double pixelComplexity;
+
+            /// \brief A complexity of 1 for every region.
+            static double regionCount(const Node *node);
+
+            /// \brief The sum of the squared differences of the pixel values from the mean
+            /// of the region.
+            static double squaredError(const Node *node);
+    };
+
+    /// \class ScaleSets
+    ///
+    /// \brief The optimal cuts of an `ImageTree` for all the values of `lambda` (the
+    /// scale-set representation of Guigues et al.).
+    ///
+    /// A `Node` is part of the optimal cut for `lambda` in an interval
+    /// [`appearance()`, `disappearance()`): the cuts are nested, coarser for larger
+    /// `lambda`. The scales of appearance are found in a single bottom-up pass: the
+    /// optimal energy of every subtree is a concave piecewise-linear function of
+    /// `lambda`, and its breakpoints (the appearances of the `Node`s in the subtree)
+    /// are kept in mergeable heaps, in O(n log n) for n `Node`s.
+    ///
+    /// \note Obtained with `ImageTree::scaleSets()`. The `ImageTree` must not be
+    /// modified (e.g. filtered) while the index is in use.
+    class ScaleSets{
+        public:
+            /// \brief Constructor, indexing \p tree.
+            ScaleSets(const ImageTree &tree, const CutEnergy &energy);
+
+            /// \brief The number of `Node`s in the tree.
+            int size() const;
+
+            /// \brief The `Node` at the index \p i (in top-down order).
+            Node *node(int i) const;
+
+            /// \brief The smallest `lambda` for which the `Node` is better than any
+            /// partition of it.
+            double appearance(int i) const;
+
+            /// \brief The smallest `lambda` for which an ancestor replaces the `Node`.
+            double disappearance(int i) const;
+
+            /// \brief Whether the `Node` is part of the optimal cut for some `lambda`.
+            bool persistent(int i) const;
+
+            /// \brief The values of `lambda` at which the optimal cut changes, increasing.
+            const std::vector <double> &scales() const;
+
+            /// \brief The energy of the optimal cut for \p lambda.
+            double energy(double lambda) const;
+
+            /// \brief The regions of the optimal cut for \p lambda.
+            void cut(double lambda, std::vector <Node *> &regions) const;
+
+            /// \brief Label the regions of the optimal cut for \p lambda.
+            void cut(double lambda, cv::Mat &labels) const;
+
+        private:
+            const ImageTree *tree;
+            std::vector <Node *> order;
+            std::vector <int> parentIdx;
+            std::vector <double> appear;
+            std::vector <double> disappear;
+
+            /// \brief The energy is `curveIntercept[k] + lambda * curveSlope[k]` between
+            /// `breakpoints[k-1]` and `breakpoints[k]`.
+            std::vector <double> breakpoints;
+            std::vector <double> curveIntercept, curveSlope;
+
+            void regions(double lambda, std::vector <int> &region) const;
+    };
+}
+
+#endif // SCALESETS_H
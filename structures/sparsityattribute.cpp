@@ -5,62 +5,180 @@
 
 #include "node.h"
 
+#include <climits>
+#include <iterator>
+
 const std::string fl::SparsityAttribute::name = "sparsity";
 
+namespace fl{
+    namespace detail{
+        class compareByRow{
+            public:
+                compareByRow(){}
+                bool operator() (const cv::Point &lhs, const cv::Point &rhs) const{
+                    return lhs.y < rhs.y || (lhs.y == rhs.y && lhs.x < rhs.x);
+                }
+        };
+
+        inline long long hullCross(const cv::Point &o, const cv::Point &a, const cv::Point &b){
+            return (long long)(a.x - o.x) * (b.y - o.y) - (long long)(a.y - o.y) * (b.x - o.x);
+        }
+    }
+}
+
 /// \details \copydetails Attribute::Attribute()
 fl::SparsityAttribute::SparsityAttribute(const Node *baseNode, const ImageTree *baseTree, AttributeSettings *settings, int deleteSettings)
-    : TypedAttribute<double>(baseNode, baseTree, settings, deleteSettings) { this->initSettings(); }
+    : TypedAttribute<double>(baseNode, baseTree, settings, deleteSettings), hullReleased(false) { this->initSettings(); }
 
 fl::SparsityAttribute::~SparsityAttribute() { }
 
 /// Calculation of the `SparsityAttribute`. The calculation is done efficiently, by re-using
-/// the `SparsityAttribute` of any child `Node`s in the `ImageTree`.
+/// the convex hulls of any child `Node`s in the `ImageTree`.
 /// Any image element (pixel) position in the `ImageTree` is retrieved at most once.
+///
+/// Only the leftmost and the rightmost own pixel of every row can be a vertex of the convex hull,
+/// so only those are merged with the (already sorted) convex hulls of the children. The merged
+/// sequence stays sorted, and the convex hull is obtained in linear time by `monotoneChain()`.
+///
+/// If `SparsitySettings::releaseChildHulls` is set, the convex hulls of the children are released
+/// once they have been merged. A child with a released hull (e.g. when the value of the `Node`
+/// is recalculated) is recalculated first.
 void fl::SparsityAttribute::calculateAttribute(){
-    //this->attValue = this->myNode->getOwnElements().size();
-
-    //const std::vector <std::pair <int, int> > &getOwnElements() const;
+    SparsitySettings *mys = (SparsitySettings *)(this->getSettings());
 
-    std::vector <cv::Point2f> for_calc;
+    std::vector <cv::Point> for_calc;
+    std::vector <int> runs(1, 0);
     std::vector <Attribute *> childAttributes;
 
-    std::vector <cv::Point2f> for_calc_control;
-    std::vector <cv::Point2f> convex_hull_control;
+    const std::vector <std::pair<int, int> > &own_points = this->myNode->getOwnElements();
+    int myArea = own_points.size();
+
+    if (!own_points.empty()){
+        int minRow = own_points[0].second, maxRow = own_points[0].second;
+        for (int i=1, szi = own_points.size(); i < szi; ++i){
+            minRow = std::min(minRow, own_points[i].second);
+            maxRow = std::max(maxRow, own_points[i].second);
+        }
+
+        if (maxRow - minRow < 2 * (int)own_points.size()){
+            // dense rows, keep the extremes in a table indexed by row
+            std::vector <std::pair <int, int> > extremes(maxRow - minRow + 1, std::make_pair(INT_MAX, INT_MIN));
+            for (int i=0, szi = own_points.size(); i < szi; ++i){
+                std::pair <int, int> &ext = extremes[own_points[i].second - minRow];
+                ext.first = std::min(ext.first, own_points[i].first);
+                ext.second = std::max(ext.second, own_points[i].first);
+            }
+            for (int i=0, szi = extremes.size(); i < szi; ++i){
+                if (extremes[i].first > extremes[i].second)
+                    continue;
+                for_calc.emplace_back(cv::Point(extremes[i].first, minRow + i));
+                if (extremes[i].second != extremes[i].first)
+                    for_calc.emplace_back(cv::Point(extremes[i].second, minRow + i));
+            }
+        }
+        else{
+            // sparse rows, sort the own pixels and keep the first and the last of every row
+            std::vector <cv::Point> own;
+            own.reserve(own_points.size());
+            for (int i=0, szi = own_points.size(); i < szi; ++i)
+                own.emplace_back(cv::Point(own_points[i].first, own_points[i].second));
+            std::sort(own.begin(), own.end(), detail::compareByRow());
+            for (int i=0, szi = own.size(); i < szi; ++i){
+                if (i == 0 || own[i].y != own[i-1].y || i+1 == szi || own[i].y != own[i+1].y)
+                    for_calc.push_back(own[i]);
+            }
+        }
+        runs.push_back(for_calc.size());
+    }
 
     this->myNode->getChildrenAttributes(SparsityAttribute::name, childAttributes);
-    int myArea =0;
 
     for (int i=0, szi = childAttributes.size(); i < szi; ++i){
         SparsityAttribute *chat = ((SparsityAttribute *)childAttributes[i]);
+        if (chat->hullReleased)
+            chat->vset() = false;
         chat->value();
         for_calc.insert(for_calc.end(), chat->convex_hull.begin(), chat->convex_hull.end());
+        runs.push_back(for_calc.size());
         myArea += chat->area;
-        //this->attValue += ((AreaAttribute *)childAttributes[i])->value();
+        if (mys->releaseChildHulls){
+            std::vector <cv::Point>().swap(chat->convex_hull);
+            chat->hullReleased = true;
+        }
     }
 
-    const std::vector <std::pair<int, int> > &own_points = this->myNode->getOwnElements();
-    myArea += own_points.size();
-
     this->area = myArea;
 
-    for (int i=0, szi = own_points.size(); i < szi; ++i)
-        for_calc.emplace_back(cv::Point2f(own_points[i].second, own_points[i].first));
-
-    cv::convexHull(cv::Mat(for_calc), this->convex_hull, false);
+    // merge the sorted runs pairwise, O(n log k) for k runs
+    while (runs.size() > 2){
+        std::vector <int> merged(1, 0);
+        for (int i=0, szi = runs.size(); i+1 < szi; i += 2){
+            if (i+2 < szi){
+                std::inplace_merge(for_calc.begin() + runs[i], for_calc.begin() + runs[i+1],
+                                   for_calc.begin() + runs[i+2], detail::compareByRow());
+                merged.push_back(runs[i+2]);
+            }
+            else
+                merged.push_back(runs[i+1]);
+        }
+        runs.swap(merged);
+    }
+    for_calc.erase(std::unique(for_calc.begin(), for_calc.end()), for_calc.end());
 
-//    // Now calculate the area of convex hull 'ch':
-//    double area = 0;
-//    for (int i = 0, szi = this->convex_hull.size(); i < szi; ++i){
-//        int next_i = (i+1)%(szi);
-//        double dX   = this->convex_hull[next_i].x - this->convex_hull[i].x;
-//        double avgY = (this->convex_hull[next_i].y + this->convex_hull[i].y)/2;
-//        area += dX*avgY;  // This is the integration step.
-//    }
+    double hullArea = SparsityAttribute::monotoneChain(for_calc, this->convex_hull);
+    this->hullReleased = false;
 
-    if (myArea >= std::abs(cv::contourArea(this->convex_hull)))
+    if (myArea >= hullArea)
         this->attValue = 1;
     else
-        this->attValue = (double)myArea / std::abs(cv::contourArea(this->convex_hull));
+        this->attValue = (double)myArea / hullArea;
 
     TypedAttribute<double>::calculateAttribute();
 }
+
+/// Andrew's monotone chain algorithm on a sequence already sorted by row and then column,
+/// without duplicates. The lower and the upper chain are built in a single pass each, and
+/// the area enclosed by them is accumulated with the shoelace formula.
+///
+/// \param sorted The candidate points, sorted by row and then column.
+///
+/// \param hull Output, the vertices of the convex hull, again sorted by row and then column,
+/// so that they can be directly merged into the convex hull of the parent.
+///
+/// \return The area of the convex hull (0 for degenerate hulls).
+double fl::SparsityAttribute::monotoneChain(const std::vector <cv::Point> &sorted, std::vector <cv::Point> &hull){
+    int n = sorted.size();
+    hull.clear();
+    if (n < 3){
+        hull.assign(sorted.begin(), sorted.end());
+        return 0;
+    }
+
+    std::vector <cv::Point> chain(2*n);
+    int k = 0;
+    for (int i = 0; i < n; ++i){
+        while (k >= 2 && detail::hullCross(chain[k-2], chain[k-1], sorted[i]) <= 0)
+            --k;
+        chain[k++] = sorted[i];
+    }
+    int lowerSize = k;
+    for (int i = n-2, t = k+1; i >= 0; --i){
+        while (k >= t && detail::hullCross(chain[k-2], chain[k-1], sorted[i]) <= 0)
+            --k;
+        chain[k++] = sorted[i];
+    }
+    --k; // the first point is repeated at the end
+
+    long long area2 = 0;
+    for (int i = 0; i < k; ++i)
+        area2 += (long long)chain[i].x * chain[i+1].y - (long long)chain[i+1].x * chain[i].y;
+
+    // the lower chain is in order, the upper one reversed
+    hull.reserve(k);
+    std::vector <cv::Point>::const_iterator lowerEnd = chain.cbegin() + lowerSize;
+    std::vector <cv::Point>::const_reverse_iterator upperBegin(chain.begin() + k), upperEnd(lowerEnd);
+    std::merge(chain.cbegin(), lowerEnd, upperBegin, upperEnd, std::back_inserter(hull), detail::compareByRow());
+    hull.erase(std::unique(hull.begin(), hull.end()), hull.end());
+
+    return std::abs((double)area2) / 2.0;
+}
@@ -17,12 +17,20 @@ namespace fl{
     /// \brief Holder for all the `AttributeSettings` of the `SparsityAttribute`
     class SparsitySettings : public AttributeSettings {
         public:
-            SparsitySettings() {} ///< The constructor of `SparsitySettings`.
+            /// \brief The constructor of `SparsitySettings`.
+            ///
+            /// \param releaseChildHulls If `true`, the convex hulls of the child `Node`s are
+            /// released as soon as the hull of their parent has been calculated, keeping only
+            /// the hulls along the current calculation front in memory. A released hull is
+            /// recalculated when needed again. Default `false`.
+            SparsitySettings(bool releaseChildHulls = false) : releaseChildHulls(releaseChildHulls) {}
             ~SparsitySettings() {} ///< The destructor of `SparsitySettings`
 
             virtual SparsitySettings* clone() const{
                 return new SparsitySettings(*this);
             }
+
+            bool releaseChildHulls; ///< Release the child convex hulls once they were merged into the parent.
     };
 
 /// \class SparsityAttribute
@@ -31,6 +39,10 @@ namespace fl{
 ///
 /// This is not an increasing attribute. It is calculated as the ratio of the
 /// area of the region and convex hull of the region.
+///
+/// The convex hull of a `Node` is obtained by merging the (sorted) convex hulls of
+/// its children with the row extremes of its own pixels, followed by a linear-time
+/// monotone chain pass.
     class SparsityAttribute : public TypedAttribute<double>{
         public:
             static const std::string name;
@@ -44,9 +56,15 @@ namespace fl{
             /// \brief Triggers the calculation of the `SparsityAttribute` value for a `Node`.
             virtual void calculateAttribute();
         protected:
-            std::vector <cv::Point2f> convex_hull;
+            /// \brief Vertices of the convex hull of the region, sorted by row and then column.
+            std::vector <cv::Point> convex_hull;
+            /// \brief Indicator that `convex_hull` was released after merging it into the parent.
+            bool hullReleased;
             int area; // do this better
         private:
+            /// \brief Builds the convex hull from points sorted by row and then column,
+            /// and returns the area of the hull.
+            static double monotoneChain(const std::vector <cv::Point> &sorted, std::vector <cv::Point> &hull);
     };
 }
 
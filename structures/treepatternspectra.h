@@ -0,0 +1,314 @@
+/// \file structures/treepatternspectra.h
+/// \author Petra Bosilj
+///
+/// \brief The definitions of the `ImageTree` member templates calculating pattern spectra
+/// in a single pass over the `Node`s: `ImageTree::globalPatternSpectra2D()`,
+/// `ImageTree::localPatternSpectra2D()` and `ImageTree::patternSpectrumND()`.
+///
+/// Kept out of `imagetree.tpp`, as `patternspectra2d.h` needs `maxTreeNister()`, whose
+/// header includes `imagetree.h`. Include this header to use these methods.
+
+#ifndef TREEPATTERNSPECTRA_H
+#define TREEPATTERNSPECTRA_H
+
+#include "imagetree.h"
+
+#include "areaattribute.h"
+#include "patternspectra2d.h"
+#include "patternspectrumnd.h"
+
+#include "../misc/parallel.h"
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace fl{
+
+/// Produces the same values as the matrix of the `PatternSpectra2D<AT1,AT2>` of the
+/// root (cf. `addPatternSpectra2DToTree()`), but bins the `Attribute` values of every
+/// `Node` only once and adds |`level()` - parent `level()`| * area directly into a single
+/// flat histogram, instead of storing a matrix at every `Node` and summing the matrices
+/// of the children. The areas are accumulated in a bottom-up pass over a flat array.
+/// In parallel mode, the `Node`s are split into blocks, each accumulated into its own
+/// histogram, and the histograms are summed at the end.
+///
+/// \tparam AT1 The first `TypedAttribute` (e.g. `AreaAttribute`). Must be assigned to
+/// the tree with `addAttributeToTree` beforehand.
+/// \tparam AT2 The second `TypedAttribute` (e.g. `NonCompactnessAttribute`). Must be
+/// assigned to the tree with `addAttributeToTree` beforehand.
+///
+/// \param settings The `PatternSpectra2DSettings` of the spectrum. The `Binning`s can
+/// not use `NODE_VAL` (relative bin sizes), and `storeValue` is ignored.
+/// \param ps Output, the spectrum as a row-major (`firstAttBin.nBins`+2) x
+/// (`secondAttBin.nBins`+2) array, including the bins for the values out of range
+/// (the layout of `AnyPatternSpectra2D::getPatternSpectraMatrix()`).
+/// \param parallel (optional) If `true` (default), the `Node`s are binned in parallel.
+template<class AT1, class AT2>
+void ImageTree::globalPatternSpectra2D(const PatternSpectra2DSettings &settings, std::vector <double> &ps, bool parallel) const{
+    if (settings.firstAttBin.maxValue == NODE_VAL || settings.secondAttBin.maxValue == NODE_VAL){
+        std::cerr << "Relative bin sizes not allowed for the global pattern spectra." << std::endl;
+        std::exit(-5);
+    }
+    PatternSpectra2DSettings current(settings);
+
+    std::vector <fl::Node *> order;
+    std::vector <int> parentIdx;
+    this->topDownOrder(order, parentIdx);
+    int szn = order.size();
+
+    std::vector <int> area(szn, 0);
+    for (int i = szn-1; i >= 0; --i){
+        area[i] += order[i]->_S.size();
+        if (i > 0)
+            area[parentIdx[i]] += area[i];
+    }
+
+    if (current.cutOff && AT1::name == "area")
+        PatternSpectra2D<AT1,AT2>::setCutOffLimits(&current, this->_root->getAttribute(AT2::name)->mySettings);
+    int areaNorm = current.areaNormalize ? area[0] : 1;
+
+    // attribute values are read sequentially (bottom-up), since they might be calculated on first access
+    this->ensureDefaultSettings<AT1>();
+    this->ensureDefaultSettings<AT2>();
+    std::vector <double> values1(szn), values2(szn);
+    for (int i = szn-1; i >= 0; --i){
+        values1[i] = double(((AT1 *)order[i]->getAttribute(AT1::name))->value());
+        values2[i] = double(((AT2 *)order[i]->getAttribute(AT2::name))->value());
+    }
+    this->revertSettingsChanges<AT1>();
+    this->revertSettingsChanges<AT2>();
+
+    const Binning &bin1 = current.firstAttBin, &bin2 = current.secondAttBin;
+    const std::vector <double> &upperLimits = current.upperLimits;
+    int dim2 = bin2.nBins + 2;
+    int szh = (bin1.nBins + 2) * dim2;
+    int blocks = parallel ? std::max(1, std::min(cv::getNumThreads() * 4, szn / 4096)) : 1;
+    std::vector <double> partial((size_t)blocks * szh, 0);
+
+    detail::parallelFor(blocks, [&](int begin, int end){
+        std::vector <int> bins1, bins2;
+        for (int b = begin; b < end; ++b){
+            double *hist = &partial[(size_t)b * szh];
+            int from = std::max(1LL, (long long)szn * b / blocks), to = (long long)szn * (b+1) / blocks; // the root has no parent
+            if (from >= to)
+                continue;
+            bins1.resize(to - from);
+            bins2.resize(to - from);
+            bin1.getBins(&values1[from], &bins1[0], to - from);
+            bin2.getBins(&values2[from], &bins2[0], to - from);
+            for (int i = from; i < to; ++i){
+                int b1 = bins1[i - from];
+                int b2 = bins2[i - from];
+                if (b1 == 0 || b2 == 0 || b1 == (bin1.nBins +1) || b2 == (bin2.nBins +1) ||
+                    current.cutOff == false || b2 <= upperLimits[b1-1])
+                    hist[b1 * dim2 + b2] += std::abs(order[i]->level() - order[parentIdx[i]]->level()) * area[i] / areaNorm;
+            }
+        }
+    }, 1);
+
+    ps.assign(szh, 0);
+    for (int b=0; b < blocks; ++b)
+        for (int j=0; j < szh; ++j)
+            ps[j] += partial[(size_t)b * szh + j];
+}
+
+/// Generalises `globalPatternSpectra2D()` to any number of `Attribute`s (e.g. size x
+/// shape x contrast): the `Node`s are binned in every dimension, in parallel, and
+/// |`level()` - parent `level()`| * area is added to the corresponding cell of \p ps,
+/// which keeps only the non-empty cells while the spectrum is sparse. With two
+/// `Attribute`s, the values equal those of `globalPatternSpectra2D()` without `cutOff`.
+///
+/// \tparam ATs The `TypedAttribute`s, one per dimension. Must be assigned to the tree
+/// with `addAttributeToTree` beforehand.
+///
+/// \param binnings The `Binning` of every dimension, in the order of \p ATs. Can not use
+/// `NODE_VAL` (relative bin sizes).
+/// \param ps Output, the pattern spectrum.
+/// \param areaNormalize (optional) If `true`, the values are normalized by the area of the image.
+template<class... ATs>
+void ImageTree::patternSpectrumND(const std::vector <Binning> &binnings, PatternSpectrumND &ps, bool areaNormalize) const{
+    const int N = sizeof...(ATs);
+    if ((int)binnings.size() != N){
+        std::cerr << "The number of binnings different from the number of attributes." << std::endl;
+        std::exit(-1);
+    }
+    std::vector <int> dims(N);
+    for (int d=0; d < N; ++d){
+        if (binnings[d].maxValue == NODE_VAL){
+            std::cerr << "Relative bin sizes not allowed for the global pattern spectra." << std::endl;
+            std::exit(-5);
+        }
+        dims[d] = binnings[d].nBins + 2;
+    }
+    ps.reset(dims);
+
+    std::vector <fl::Node *> order;
+    std::vector <int> parentIdx;
+    this->topDownOrder(order, parentIdx);
+    int szn = order.size();
+
+    std::vector <int> area(szn, 0);
+    for (int i = szn-1; i >= 0; --i){
+        area[i] += order[i]->_S.size();
+        if (i > 0)
+            area[parentIdx[i]] += area[i];
+    }
+    double areaNorm = areaNormalize ? area[0] : 1;
+
+    // attribute values are read sequentially (bottom-up), since they might be calculated on first access
+    int ensured[] = {0, (this->ensureDefaultSettings<ATs>(), 0)...};
+    std::vector <double> values((size_t)szn * N);
+    for (int i = szn-1; i >= 0; --i){
+        double row[] = {double(((ATs *)order[i]->getAttribute(ATs::name))->value())...};
+        std::copy(row, row + N, values.begin() + (size_t)i * N);
+    }
+    int reverted[] = {0, (this->revertSettingsChanges<ATs>(), 0)...};
+    (void)ensured; (void)reverted;
+
+    std::vector <long long> cell(szn, 0);
+    std::vector <double> weight(szn, 0);
+    detail::parallelFor(szn-1, [&](int begin, int end){
+        for (int i = begin+1; i < end+1; ++i){ // the root has no parent
+            long long index = 0;
+            for (int d=0; d < N; ++d)
+                index = index * dims[d] + binnings[d].getBin(values[(size_t)i * N + d]);
+            cell[i] = index;
+            weight[i] = std::abs(order[i]->level() - order[parentIdx[i]]->level()) * area[i] / areaNorm;
+        }
+    }, 1024);
+
+    for (int i=1; i < szn; ++i)
+        if (weight[i] != 0)
+            ps.add(cell[i], weight[i]);
+}
+
+/// Replaces building a separate tree for every window (e.g. for the tiled and pyramid
+/// descriptors): the tree of the whole image is used, and every `Node` contributes to
+/// the spectra of all the windows it intersects. The contribution of a `Node` to a
+/// window is calculated as in `globalPatternSpectra2D()`, using the area of the part of
+/// the region inside the window in place of its area. This area is exact for regions
+/// inside the window, and estimated from the overlap of the bounding box with the
+/// window (assuming the pixels are spread uniformly over the bounding box) otherwise.
+/// The value of \p AT is the one of the whole region.
+///
+/// The bounding boxes are accumulated bottom-up in flat arrays. For every window, the
+/// tree is traversed from the root, skipping the subtrees with the bounding boxes not
+/// intersecting the window. The windows are processed in parallel.
+///
+/// \tparam AT The shape `TypedAttribute` (e.g. `NonCompactnessAttribute`). Must be
+/// assigned to the tree with `addAttributeToTree` beforehand.
+///
+/// \param windows The windows, in image coordinates.
+/// \param settings The `PatternSpectra2DSettings`, where the first `Binning` is for the
+/// area. A `Binning` set up with `NODE_VAL` uses the area of each window as the maximum,
+/// and `areaNormalize` normalizes by the area of each window.
+/// \param spectra Output, the spectrum of each window, in the layout of
+/// `globalPatternSpectra2D()`.
+template<class AT>
+void ImageTree::localPatternSpectra2D(const std::vector <cv::Rect> &windows, const PatternSpectra2DSettings &settings,
+                                      std::vector <std::vector <double> > &spectra) const{
+    std::vector <fl::Node *> order;
+    std::vector <int> parentIdx;
+    this->topDownOrder(order, parentIdx);
+    int szn = order.size();
+
+    // in the top-down order, the children of every Node are consecutive
+    std::vector <int> firstChild(szn, szn), childCount(szn, 0);
+    std::vector <int> area(szn, 0);
+    std::vector <int> x0(szn, this->width), y0(szn, this->height), x1(szn, -1), y1(szn, -1);
+    for (int i = szn-1; i >= 0; --i){
+        const std::vector <std::pair <int, int> > &S = order[i]->_S;
+        area[i] += S.size();
+        for (int j=0, szj = S.size(); j < szj; ++j){
+            x0[i] = std::min(x0[i], S[j].X); x1[i] = std::max(x1[i], S[j].X);
+            y0[i] = std::min(y0[i], S[j].Y); y1[i] = std::max(y1[i], S[j].Y);
+        }
+        if (i == 0)
+            continue;
+        int p = parentIdx[i];
+        area[p] += area[i];
+        x0[p] = std::min(x0[p], x0[i]); x1[p] = std::max(x1[p], x1[i]);
+        y0[p] = std::min(y0[p], y0[i]); y1[p] = std::max(y1[p], y1[i]);
+        firstChild[p] = i;
+        ++childCount[p];
+    }
+
+    // attribute values are read sequentially (bottom-up), since they might be calculated on first access
+    this->ensureDefaultSettings<AT>();
+    std::vector <double> shape(szn), levels(szn);
+    for (int i = szn-1; i >= 0; --i){
+        shape[i] = double(((AT *)order[i]->getAttribute(AT::name))->value());
+        levels[i] = order[i]->level();
+    }
+    this->revertSettingsChanges<AT>();
+
+    // the settings (and the cut-off limits) are prepared once for every window area
+    std::vector <PatternSpectra2DSettings> local;
+    std::vector <int> settingsIdx(windows.size());
+    std::map <int, int> byArea;
+    for (int w=0, szw = windows.size(); w < szw; ++w){
+        int windowArea = windows[w].width * windows[w].height;
+        std::map <int, int>::iterator it = byArea.find(windowArea);
+        if (it == byArea.end()){
+            PatternSpectra2DSettings current(settings);
+            if (current.firstAttBin.maxValue == NODE_VAL){
+                current.firstAttBin.setLocalRange(windowArea);
+                current.firstAttBin.compile();
+            }
+            if (current.secondAttBin.maxValue == NODE_VAL){
+                current.secondAttBin.setLocalRange(windowArea);
+                current.secondAttBin.compile();
+            }
+            if (current.cutOff)
+                PatternSpectra2D<AreaAttribute,AT>::setCutOffLimits(&current, this->_root->getAttribute(AT::name)->mySettings);
+            current.areaNorm = current.areaNormalize ? windowArea : 1;
+            it = byArea.insert(std::make_pair(windowArea, (int)local.size())).first;
+            local.push_back(current);
+        }
+        settingsIdx[w] = it->second;
+    }
+
+    spectra.assign(windows.size(), std::vector <double>());
+    detail::parallelFor(windows.size(), [&](int begin, int end){
+        std::vector <int> toProcess;
+        for (int w = begin; w < end; ++w){
+            const PatternSpectra2DSettings &current = local[settingsIdx[w]];
+            const Binning &bin1 = current.firstAttBin, &bin2 = current.secondAttBin;
+            int dim2 = bin2.nBins + 2;
+            std::vector <double> &ps = spectra[w];
+            ps.assign((bin1.nBins + 2) * dim2, 0);
+
+            int wx0 = windows[w].x, wx1 = windows[w].x + windows[w].width - 1;
+            int wy0 = windows[w].y, wy1 = windows[w].y + windows[w].height - 1;
+            toProcess.assign(1, 0);
+            while (!toProcess.empty()){
+                int i = toProcess.back();
+                toProcess.pop_back();
+
+                int cx = std::min(x1[i], wx1) - std::max(x0[i], wx0) + 1;
+                int cy = std::min(y1[i], wy1) - std::max(y0[i], wy0) + 1;
+                if (cx <= 0 || cy <= 0) // the subtree is outside of the window
+                    continue;
+                for (int j = firstChild[i], szj = firstChild[i] + childCount[i]; j < szj; ++j)
+                    toProcess.push_back(j);
+                if (i == 0) // the root has no parent
+                    continue;
+
+                double boxArea = double(x1[i] - x0[i] + 1) * (y1[i] - y0[i] + 1);
+                double clipped = area[i] * (double(cx) * cy / boxArea);
+                int b1 = bin1.getBin(clipped);
+                int b2 = bin2.getBin(shape[i]);
+                if (b1 == 0 || b2 == 0 || b1 == (bin1.nBins +1) || b2 == (bin2.nBins +1) ||
+                    current.cutOff == false || b2 <= current.upperLimits[b1-1])
+                    ps[b1 * dim2 + b2] += std::abs(levels[i] - levels[parentIdx[i]]) * clipped / current.areaNorm;
+            }
+        }
+    }, 1);
+}
+
+}
+
+#endif // TREEPATTERNSPECTRA_H
@@ -0,0 +1,179 @@
+/// \file structures/treereconstruction.cpp
+/// \author Petra Bosilj
+
+#include "treereconstruction.h"
+
+#include "imagetree.h"
+#include "node.h"
+
+#include "../misc/parallel.h"
+
+#include <unordered_map>
+#include <algorithm>
+
+namespace fl{
+    namespace detail{
+
+        /// Writes \p values (\p channels per `Node`) into the rows [\p begin, \p end) of
+        /// \p out, using the pixel-to-`Node` index \p pixelNode. Pixels not belonging to
+        /// any `Node` are set to 0.
+        template <typename T>
+        void fillRows(cv::Mat &out, const std::vector <int> &pixelNode, const std::vector <double> &values,
+                      int channels, int begin, int end){
+            for (int y = begin; y < end; ++y){
+                T *px = out.ptr<T>(y);
+                const int *idx = &pixelNode[(size_t)y * out.cols];
+                for (int x = 0, szx = out.cols; x < szx; ++x, px += channels){
+                    if (idx[x] < 0){
+                        std::fill(px, px + channels, T(0));
+                        continue;
+                    }
+                    const double *val = &values[(size_t)idx[x] * channels];
+                    for (int c=0; c < channels; ++c)
+                        px[c] = cv::saturate_cast<T>(val[c]);
+                }
+            }
+        }
+    }
+}
+
+/// \param tree The `ImageTree` to be reconstructed. Needs to outlive this object.
+fl::TreeReconstruction::TreeReconstruction(const ImageTree &tree) : tree(tree){
+    this->update();
+}
+
+/// Orders the `Node`s of the tree top-down and assigns every pixel the index
+/// of the `Node` containing it as an own element.
+void fl::TreeReconstruction::update(){
+    this->tree.topDownOrder(this->order, this->parentIdx);
+
+    int width = this->tree.treeWidth();
+    this->pixelNode.assign((size_t)width * this->tree.treeHeight(), -1);
+    for (int i=0, szi = this->order.size(); i < szi; ++i){
+        const std::vector <std::pair <int, int> > &S = this->order[i]->getOwnElements();
+        for (int j=0, szj = S.size(); j < szj; ++j)
+            this->pixelNode[(size_t)S[j].second * width + S[j].first] = i;
+    }
+}
+
+const fl::ImageTree &fl::TreeReconstruction::baseTree() const { return this->tree; }
+
+const std::vector <fl::Node *> &fl::TreeReconstruction::nodes() const { return this->order; }
+
+const std::vector <int> &fl::TreeReconstruction::parents() const { return this->parentIdx; }
+
+/// \return The index (in `nodes()`) of the `Node` containing the pixel
+/// (\p x, \p y) as own element, -1 if no `Node` contains it.
+int fl::TreeReconstruction::nodeIndex(int x, int y) const{
+    return this->pixelNode[(size_t)y * this->tree.treeWidth() + x];
+}
+
+/// Uses `Node::hyperGraylevel()` when it is set (one channel per band),
+/// and `Node::grayLevel()` otherwise.
+///
+/// \param out Output, the reconstructed image.
+/// \param depth The depth of \p out (any `cv::Mat` depth).
+void fl::TreeReconstruction::reconstruct(cv::Mat &out, int depth) const{
+    int channels = this->order[0]->hyperGraylevel().size();
+    std::vector <double> values;
+
+    if (channels == 0){
+        channels = 1;
+        values.resize(this->order.size());
+        for (int i=0, szi = this->order.size(); i < szi; ++i)
+            values[i] = this->order[i]->grayLevel();
+    }
+    else{
+        values.resize(this->order.size() * channels);
+        for (int i=0, szi = this->order.size(); i < szi; ++i){
+            const std::vector <int> &hgl = this->order[i]->hyperGraylevel();
+            for (int j=0; j < channels; ++j)
+                values[(size_t)i * channels + j] = hgl[j];
+        }
+    }
+
+    this->render(out, values, channels, depth);
+}
+
+/// \param out Output, the rendered image of type `CV_MAKETYPE(depth, channels)`.
+/// Reallocated if needed.
+/// \param nodeValues The values for each `Node` in `nodes()`, \p channels consecutive
+/// values per `Node`.
+/// \param channels The number of channels of \p out.
+/// \param depth The depth of \p out (any `cv::Mat` depth). Values are saturated.
+void fl::TreeReconstruction::render(cv::Mat &out, const std::vector <double> &nodeValues, int channels, int depth) const{
+    out.create(this->tree.treeHeight(), this->tree.treeWidth(), CV_MAKETYPE(depth, channels));
+
+    const std::vector <int> &pixelNode = this->pixelNode;
+    detail::parallelFor(out.rows, [&](int begin, int end){
+        switch (depth){
+            case CV_8U:  detail::fillRows<uchar>(out, pixelNode, nodeValues, channels, begin, end); break;
+            case CV_8S:  detail::fillRows<schar>(out, pixelNode, nodeValues, channels, begin, end); break;
+            case CV_16U: detail::fillRows<ushort>(out, pixelNode, nodeValues, channels, begin, end); break;
+            case CV_16S: detail::fillRows<short>(out, pixelNode, nodeValues, channels, begin, end); break;
+            case CV_32S: detail::fillRows<int>(out, pixelNode, nodeValues, channels, begin, end); break;
+            case CV_32F: detail::fillRows<float>(out, pixelNode, nodeValues, channels, begin, end); break;
+            default:     detail::fillRows<double>(out, pixelNode, nodeValues, channels, begin, end); break;
+        }
+    });
+}
+
+/// Counts, for every `Node`, how many of its ancestors (itself included)
+/// appear in \p toMark.
+void fl::TreeReconstruction::countMarks(const std::vector <Node *> &toMark, std::vector <int> &marks) const{
+    std::unordered_map <const Node *, int> counts;
+    for (int i=0, szi = toMark.size(); i < szi; ++i)
+        if (toMark[i] != NULL)
+            ++counts[toMark[i]];
+
+    marks.assign(this->order.size(), 0);
+    for (int i=0, szi = this->order.size(); i < szi; ++i){
+        std::unordered_map <const Node *, int>::const_iterator it = counts.find(this->order[i]);
+        marks[i] = (this->parentIdx[i] < 0 ? 0 : marks[this->parentIdx[i]]) + (it == counts.end() ? 0 : it->second);
+    }
+}
+
+/// Equivalent to calling `Node::colorSolid()` for each of \p toMark.
+///
+/// \param image The `CV_8UC3` image onto which to draw the regions.
+/// \param toMark The `Node`s to be drawn onto the image.
+/// \param value The RGB value of the flat color.
+void fl::TreeReconstruction::markNodes(cv::Mat &image, const std::vector <Node *> &toMark, const cv::Vec3b &value) const{
+    std::vector <int> marks;
+    this->countMarks(toMark, marks);
+
+    const std::vector <int> &pixelNode = this->pixelNode;
+    detail::parallelFor(image.rows, [&](int begin, int end){
+        for (int y = begin; y < end; ++y){
+            cv::Vec3b *px = image.ptr<cv::Vec3b>(y);
+            const int *idx = &pixelNode[(size_t)y * image.cols];
+            for (int x = 0, szx = image.cols; x < szx; ++x)
+                if (idx[x] >= 0 && marks[idx[x]] > 0)
+                    px[x] = value;
+        }
+    });
+}
+
+/// Equivalent to calling `Node::colorSolid()` for each of \p toMark: the
+/// intensity of a pixel is increased by \p value once for every marked `Node`
+/// containing it, saturating at 255.
+///
+/// \param image The `CV_8U` image onto which to draw the regions.
+/// \param toMark The `Node`s to be drawn onto the image.
+/// \param value The intensity to add.
+void fl::TreeReconstruction::markNodes(cv::Mat &image, const std::vector <Node *> &toMark, const cv::Scalar &value) const{
+    std::vector <int> marks;
+    this->countMarks(toMark, marks);
+
+    const std::vector <int> &pixelNode = this->pixelNode;
+    int add = (int)value.val[0];
+    detail::parallelFor(image.rows, [&](int begin, int end){
+        for (int y = begin; y < end; ++y){
+            uchar *px = image.ptr<uchar>(y);
+            const int *idx = &pixelNode[(size_t)y * image.cols];
+            for (int x = 0, szx = image.cols; x < szx; ++x)
+                if (idx[x] >= 0 && marks[idx[x]] > 0)
+                    px[x] = (uchar)std::min(px[x] + add * marks[idx[x]], 255);
+        }
+    });
+}
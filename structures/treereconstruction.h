@@ -0,0 +1,74 @@
+/// \file structures/treereconstruction.h
+/// \author Petra Bosilj
+
+#ifndef TREERECONSTRUCTION_H
+#define TREERECONSTRUCTION_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace fl{
+
+    class ImageTree;
+    class Node;
+
+    /// \class TreeReconstruction
+    ///
+    /// \brief Reconstructs images from an `ImageTree` through a pixel-to-`Node` index.
+    ///
+    /// The `Node`s of the tree are indexed in top-down order, and every pixel of the image
+    /// stores the index of the `Node` it belongs to (as own element). Reconstruction then
+    /// computes one output value per `Node`, and fills the image by looking up the `Node`
+    /// of each pixel, processing blocks of rows in parallel with a single dispatch on the
+    /// depth of the output image.
+    ///
+    /// \note The index refers to the `Node`s of the tree at the time of construction
+    /// (or of the last call to `update()`). After any modification of the tree (e.g.
+    /// filtering) `update()` needs to be called before reconstructing.
+    class TreeReconstruction{
+        public:
+            /// \brief Constructor, indexes the `Node`s and pixels of \p tree.
+            TreeReconstruction(const ImageTree &tree);
+
+            /// \brief Rebuild the index after the tree was modified.
+            void update();
+
+            /// \brief The indexed `ImageTree`.
+            const ImageTree &baseTree() const;
+
+            /// \brief The `Node`s of the tree, in top-down order.
+            const std::vector <Node *> &nodes() const;
+
+            /// \brief The index of the parent of each `Node` (-1 for the root).
+            const std::vector <int> &parents() const;
+
+            /// \brief The index of the `Node` containing a pixel as own element.
+            int nodeIndex(int x, int y) const;
+
+            /// \brief Reconstruct the image from the gray levels of the `Node`s.
+            void reconstruct(cv::Mat &out, int depth = CV_8U) const;
+
+            /// \brief Fill an image with a (vectorial) value given for each `Node`.
+            void render(cv::Mat &out, const std::vector <double> &nodeValues, int channels = 1, int depth = CV_8U) const;
+
+            /// \brief Color the pixels of the given `Node`s (and their descendants) with
+            /// a flat color.
+            void markNodes(cv::Mat &image, const std::vector <Node *> &toMark, const cv::Vec3b &value) const;
+
+            /// \brief Increase the intensity of the pixels of the given `Node`s (and their
+            /// descendants).
+            void markNodes(cv::Mat &image, const std::vector <Node *> &toMark, const cv::Scalar &value) const;
+
+        private:
+            const ImageTree &tree;
+
+            std::vector <Node *> order;
+            std::vector <int> parentIdx;
+            std::vector <int> pixelNode;
+
+            void countMarks(const std::vector <Node *> &toMark, std::vector <int> &marks) const;
+    };
+}
+
+#endif // TREERECONSTRUCTION_H
@@ -5,7 +5,7 @@
 #ifndef VALUEDEVIATIONATTRIBUTE_H
 #define VALUEDEVIATIONATTRIBUTE_H
 
-#include "attribute.h"
+#include "valuestatisticsattribute.h"
 
 namespace fl{
 
@@ -30,7 +30,10 @@ namespace fl{
 /// `Binning::logarithmic` for `PatternSpectra2D`.
 ///
 /// This is not an increasing attribute.
-    class ValueDeviationAttribute : public TypedAttribute<double>
+///
+/// The value is obtained from the `ValueStatistics` of the region, shared with
+/// `MeanAttribute` and `RangeAttribute`.
+    class ValueDeviationAttribute : public ValueStatisticsAttribute
     {
         public:
             static const std::string name;
@@ -45,7 +48,6 @@ namespace fl{
             virtual void calculateAttribute();
         protected:
         private:
-            double mean;
     };
 
 }
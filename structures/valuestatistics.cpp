@@ -0,0 +1,48 @@
+/// \file structures/valuestatistics.cpp
+/// \author Petra Bosilj
+
+#include "valuestatistics.h"
+
+#include "../misc/pixels.h"
+#include "../misc/commontreedetail.h"
+
+fl::ValueStatistics::ValueStatistics() : n(0), mu(0), m2(0), minV(0), maxV(0) {}
+
+fl::ValueStatistics::~ValueStatistics() {}
+
+void fl::ValueStatistics::clear(){
+    this->n = 0;
+    this->mu = this->m2 = 0;
+    this->minV = this->maxV = 0;
+}
+
+/// Reads the values of \p img at the positions \p elements and adds them to the
+/// accumulator, in a single pass and without storing the values.
+///
+/// \param img The image holding the values.
+/// \param elements The positions of the image elements (pixels) to add.
+void fl::ValueStatistics::addElements(const cv::Mat &img, const std::vector <std::pair <int, int> > &elements){
+    for (int i=0, szi = elements.size(); i < szi; ++i)
+        this->add(detail::getCvMatElem(img, elements[i].X, elements[i].Y));
+}
+
+/// Combines the statistics of \p other with the statistics held by this accumulator, as if
+/// all the values accumulated in \p other were added here. The values of the two accumulators
+/// are assumed to be disjoint (e.g. belonging to disjoint regions of the image).
+///
+/// \param other The statistics to be merged into this accumulator.
+void fl::ValueStatistics::merge(const ValueStatistics &other){
+    if (!other.n)
+        return;
+    if (!this->n){
+        *this = other;
+        return;
+    }
+    long long total = this->n + other.n;
+    double delta = other.mu - this->mu;
+    this->mu += delta * other.n / total;
+    this->m2 += other.m2 + delta * delta * ((double)this->n * other.n / total);
+    this->n = total;
+    this->minV = std::min(this->minV, other.minV);
+    this->maxV = std::max(this->maxV, other.maxV);
+}
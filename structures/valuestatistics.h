@@ -0,0 +1,79 @@
+/// \file structures/valuestatistics.h
+/// \author Petra Bosilj
+
+#ifndef VALUESTATISTICS_H
+#define VALUESTATISTICS_H
+
+#include <vector>
+#include <utility>
+
+#include <opencv2/core/core.hpp>
+
+namespace fl{
+
+    /// \class ValueStatistics
+    ///
+    /// \brief A mergeable accumulator of the first and second order statistics (and the extremes)
+    /// of the pixel values of a region.
+    ///
+    /// The values are accumulated in a single pass with the Welford update, and the statistics of
+    /// two disjoint regions are combined with the formula of Chan et al. Merging is associative, so
+    /// the statistics of a `Node` can be obtained from those of its children in any order.
+    class ValueStatistics{
+        public:
+            /// \brief Constructor for `ValueStatistics`, creates an empty accumulator.
+            ValueStatistics();
+
+            /// \brief Destructor for `ValueStatistics`.
+            ~ValueStatistics();
+
+            /// \brief Empties the accumulator.
+            void clear();
+
+            /// \brief Adds a single value to the accumulator.
+            void add(double value){
+                if (!this->n){
+                    this->minV = this->maxV = value;
+                }
+                else{
+                    if (value < this->minV) this->minV = value;
+                    if (value > this->maxV) this->maxV = value;
+                }
+                ++this->n;
+                double delta = value - this->mu;
+                this->mu += delta / this->n;
+                this->m2 += delta * (value - this->mu);
+            }
+
+            /// \brief Adds the values of the image elements at the given positions.
+            void addElements(const cv::Mat &img, const std::vector <std::pair <int, int> > &elements);
+
+            /// \brief Merges the statistics of a disjoint set of values into this accumulator.
+            void merge(const ValueStatistics &other);
+
+            /// \brief The number of accumulated values.
+            long long count() const { return this->n; }
+
+            /// \brief The mean of the accumulated values.
+            double mean() const { return this->mu; }
+
+            /// \brief The (population) variance of the accumulated values.
+            double variance() const { return this->n ? this->m2 / this->n : 0.0; }
+
+            /// \brief The smallest accumulated value.
+            double minValue() const { return this->minV; }
+
+            /// \brief The largest accumulated value.
+            double maxValue() const { return this->maxV; }
+
+            /// \brief The difference between the largest and the smallest accumulated value.
+            double range() const { return this->maxV - this->minV; }
+        private:
+            long long n;
+            double mu;
+            double m2;
+            double minV, maxV;
+    };
+}
+
+#endif // VALUESTATISTICS_H
@@ -0,0 +1,67 @@
+/// \file structures/valuestatisticsattribute.cpp
+/// \author Petra Bosilj
+
+#include "valuestatisticsattribute.h"
+
+#include "meanattribute.h"
+#include "valuedeviationattribute.h"
+#include "rangeattribute.h"
+
+#include "node.h"
+#include "imagetree.h"
+
+#include <iostream>
+#include <cstdlib>
+
+/// \details \copydetails Attribute::Attribute()
+fl::ValueStatisticsAttribute::ValueStatisticsAttribute(const Node *baseNode, const ImageTree *baseTree, AttributeSettings *settings, int deleteSettings)
+    : TypedAttribute<double>(baseNode, baseTree, settings, deleteSettings) { }
+
+fl::ValueStatisticsAttribute::~ValueStatisticsAttribute() { }
+
+/// Calculates the `ValueStatistics` of the region in a single pass over the own pixels
+/// of the `Node`, merging the statistics of the child `Node`s of the same `Attribute`.
+/// If a different `ValueStatisticsAttribute` has already been calculated for the same
+/// `Node`, its statistics are copied instead.
+/// Any image element (pixel) position in the `ImageTree` is examined at most once.
+///
+/// \param attributeName The name of the calling `Attribute`, used to retrieve the `Attribute`s
+/// of the child `Node`s.
+///
+/// \note The image needs to be associated to the `ImageTree` before
+/// this function is called. This can be done by `ImageTree::setImage`.
+/// After the calculation the image can be discarded by `ImageTree::unsetImage`.
+void fl::ValueStatisticsAttribute::calculateStatistics(const std::string &attributeName){
+    const std::string *statisticsNames[] = {&MeanAttribute::name, &ValueDeviationAttribute::name, &RangeAttribute::name};
+    for (int i=0; i < 3; ++i){
+        if (*statisticsNames[i] == attributeName)
+            continue;
+        ValueStatisticsAttribute *other = (ValueStatisticsAttribute *)(this->myNode->getAttribute(*statisticsNames[i]));
+        if (other != NULL && other->valueSet){
+            this->stats = other->stats;
+            return;
+        }
+    }
+
+    if (! this->myTree->imageSet()){
+        std::cerr << "Image not set for the ImageTree, giving up." << std::endl;
+        std::exit(-2);
+    }
+
+    this->stats.clear();
+    this->stats.addElements(this->myTree->image(), this->myNode->getOwnElements());
+
+    std::vector <Attribute *> childAttributes;
+    this->myNode->getChildrenAttributes(attributeName, childAttributes);
+    for (int i=0, szi = childAttributes.size(); i < szi; ++i){
+        ValueStatisticsAttribute *chat = ((ValueStatisticsAttribute *)childAttributes[i]);
+        chat->value();
+        this->stats.merge(chat->stats);
+    }
+}
+
+/// The statistics are calculated on first access, as the value of the `Attribute`.
+const fl::ValueStatistics &fl::ValueStatisticsAttribute::statistics(){
+    this->value();
+    return this->stats;
+}
@@ -0,0 +1,48 @@
+/// \file structures/valuestatisticsattribute.h
+/// \author Petra Bosilj
+
+#ifndef VALUESTATISTICSATTRIBUTE_H
+#define VALUESTATISTICSATTRIBUTE_H
+
+#include "attribute.h"
+#include "valuestatistics.h"
+
+namespace fl{
+
+/// \class ValueStatisticsAttribute
+///
+/// \brief Common base of the `Attribute`s derived from the statistics of the pixel values of
+/// the region (`MeanAttribute`, `ValueDeviationAttribute` and `RangeAttribute`).
+///
+/// Each `Node` holds a `ValueStatistics` accumulator, obtained by merging the accumulators of
+/// its children with the values of its own pixels. If another of these `Attribute`s has
+/// already been calculated for the same `Node`, its accumulator is re-used, so that all of
+/// them can be obtained from a single traversal of the `ImageTree`.
+///
+/// \note The calculation of these attributes requires reading the pixel values. The corresponding
+/// image has to be assigned with `ImageTree::setImage()`.
+    class ValueStatisticsAttribute : public TypedAttribute<double>
+    {
+        public:
+            /// \brief The constructor for `ValueStatisticsAttribute`.
+            ValueStatisticsAttribute(const Node *baseNode, const ImageTree *baseTree, AttributeSettings *settings, int deleteSettings = false);
+
+            /// \brief The destructor for `ValueStatisticsAttribute`.
+            virtual ~ValueStatisticsAttribute();
+
+            /// \brief Triggers the calculation of the `Attribute` value for a `Node`.
+            virtual void calculateAttribute() = 0;
+
+            /// \brief The statistics of the pixel values of the region.
+            const ValueStatistics &statistics();
+        protected:
+            /// \brief Calculates the `ValueStatistics` of the region.
+            void calculateStatistics(const std::string &attributeName);
+
+            /// \brief The statistics of the pixel values of the region.
+            ValueStatistics stats;
+        private:
+    };
+}
+
+#endif // VALUESTATISTICSATTRIBUTE_H